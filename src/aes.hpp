@@ -0,0 +1,358 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+#   define AES_HAS_ARM_CE
+#   include <arm_neon.h>
+#endif
+
+// AES-NI is built on every x86 host and selected at runtime, see aes_ni_supported()
+#if defined(__x86_64__) || defined(__i386__)
+#   define AES_HAS_AES_NI
+#   include <immintrin.h>
+#   define AES_NI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
+namespace aes {
+
+// AES-128 in CTR mode. Every backend exposes the same interface:
+//   Backend(const Block &key, const Block &ctr);
+//   void reset(const Block &ctr);
+//   void crypt(void *dst, const void *src, std::size_t size); // Can be done in place
+// and keeps the keystream position across calls, so data can be processed in chunks of any size
+using Block = std::array<std::uint8_t, 0x10>;
+using RoundKeys = std::array<Block, 11>;
+
+namespace impl {
+
+constexpr std::uint8_t xtime(std::uint8_t x) {
+    return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+}
+
+constexpr std::uint8_t gmul(std::uint8_t a, std::uint8_t b) {
+    std::uint8_t res = 0;
+    for (; b; b >>= 1, a = xtime(a))
+        if (b & 1)
+            res ^= a;
+    return res;
+}
+
+constexpr std::array<std::uint8_t, 0x100> make_sbox() {
+    std::array<std::uint8_t, 0x100> sbox = {};
+    for (std::size_t i = 0; i < sbox.size(); ++i) {
+        // Multiplicative inverse in GF(2^8), followed by the affine transformation
+        std::uint8_t inv = 0;
+        for (std::size_t j = 1; (i != 0) && (j < 0x100); ++j)
+            if (gmul(i, j) == 1)
+                inv = j, j = 0x100;
+
+        std::uint8_t s = inv;
+        for (auto k = 1; k < 5; ++k)
+            s ^= (inv << k) | (inv >> (8 - k));
+        sbox[i] = s ^ 0x63;
+    }
+    return sbox;
+}
+
+constexpr auto sbox = make_sbox();
+
+// Combined SubBytes and MixColumns, for the little-endian column layout used by SoftCtr
+constexpr std::array<std::uint32_t, 0x100> make_te() {
+    std::array<std::uint32_t, 0x100> te = {};
+    for (std::size_t i = 0; i < te.size(); ++i) {
+        std::uint8_t s = sbox[i];
+        te[i] = gmul(s, 2) | (s << 8) | (s << 16) | (gmul(s, 3) << 24);
+    }
+    return te;
+}
+
+constexpr auto te = make_te();
+
+static_assert(sbox[0x00] == 0x63 && sbox[0x53] == 0xed && sbox[0xff] == 0x16);
+
+constexpr RoundKeys expand_key(const Block &key) {
+    RoundKeys rk = {};
+    rk[0] = key;
+
+    std::uint8_t rcon = 1;
+    for (std::size_t i = 1; i < rk.size(); ++i, rcon = xtime(rcon)) {
+        auto &prev = rk[i - 1];
+        auto &cur  = rk[i];
+        cur[0] = prev[0] ^ sbox[prev[13]] ^ rcon;
+        cur[1] = prev[1] ^ sbox[prev[14]];
+        cur[2] = prev[2] ^ sbox[prev[15]];
+        cur[3] = prev[3] ^ sbox[prev[12]];
+        for (std::size_t j = 4; j < cur.size(); ++j)
+            cur[j] = prev[j] ^ cur[j - 4];
+    }
+    return rk;
+}
+
+inline void increment(Block &ctr) {
+    for (std::size_t i = ctr.size(); i > 0; --i)
+        if (++ctr[i - 1])
+            break;
+}
+
+inline void xor_block(std::uint8_t *dst, const std::uint8_t *src, const std::uint8_t *ks, std::size_t size = 0x10) {
+    for (std::size_t i = 0; i < size; ++i)
+        dst[i] = src[i] ^ ks[i];
+}
+
+// Keystream bookkeeping common to all software-driven backends.
+// Derived classes implement crypt_blocks(dst, src, count), which processes whole blocks and advances the counter
+template <typename Derived>
+class CtrMode {
+    protected:
+        Block ctr = {}, ks = {};
+        std::size_t ks_off = 0x10;
+
+    public:
+        inline void reset(const Block &ctr) {
+            this->ctr    = ctr;
+            this->ks_off = 0x10;
+        }
+
+        void crypt(void *dst, const void *src, std::size_t size) {
+            auto *d = static_cast<std::uint8_t *>(dst);
+            auto *s = static_cast<const std::uint8_t *>(src);
+
+            // Finish the block left over by the previous call
+            if (auto count = std::min(size, 0x10 - this->ks_off); count) {
+                xor_block(d, s, this->ks.data() + this->ks_off, count);
+                this->ks_off += count, d += count, s += count, size -= count;
+            }
+
+            if (auto count = size / 0x10; count) {
+                static_cast<Derived *>(this)->crypt_blocks(d, s, count);
+                d += count * 0x10, s += count * 0x10, size -= count * 0x10;
+            }
+
+            if (size) {
+                this->ks = {};
+                static_cast<Derived *>(this)->crypt_blocks(this->ks.data(), this->ks.data(), 1);
+                xor_block(d, s, this->ks.data(), size);
+                this->ks_off = size;
+            }
+        }
+};
+
+} // namespace impl
+
+// Portable table-based implementation
+class SoftCtr: public impl::CtrMode<SoftCtr> {
+    public:
+        constexpr static auto name = "soft";
+
+    private:
+        std::array<std::uint32_t, 44> rk;
+
+    public:
+        SoftCtr(const Block &key, const Block &ctr) {
+            auto keys = impl::expand_key(key);
+            std::memcpy(this->rk.data(), keys.data(), sizeof(this->rk));
+            this->reset(ctr);
+        }
+
+        void crypt_blocks(std::uint8_t *dst, const std::uint8_t *src, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i, dst += 0x10, src += 0x10) {
+                std::uint8_t ks[0x10];
+                this->encrypt_block(ks, this->ctr.data());
+                impl::xor_block(dst, src, ks);
+                impl::increment(this->ctr);
+            }
+        }
+
+    private:
+        constexpr static std::uint32_t rotl(std::uint32_t x, int n) {
+            return (x << n) | (x >> (32 - n));
+        }
+
+        inline void encrypt_block(std::uint8_t *out, const std::uint8_t *in) const {
+            using impl::te, impl::sbox;
+
+            std::uint32_t s[4], t[4];
+            std::memcpy(s, in, sizeof(s));
+            for (auto i = 0; i < 4; ++i)
+                s[i] ^= this->rk[i];
+
+            for (auto r = 1; r < 10; ++r) {
+                for (auto c = 0; c < 4; ++c)
+                    t[c] = te[s[c] & 0xff] ^ rotl(te[(s[(c + 1) % 4] >> 8) & 0xff], 8)
+                        ^ rotl(te[(s[(c + 2) % 4] >> 16) & 0xff], 16) ^ rotl(te[s[(c + 3) % 4] >> 24], 24) ^ this->rk[4 * r + c];
+                std::memcpy(s, t, sizeof(s));
+            }
+
+            for (auto c = 0; c < 4; ++c)
+                t[c] = (sbox[s[c] & 0xff] | (sbox[(s[(c + 1) % 4] >> 8) & 0xff] << 8)
+                    | (sbox[(s[(c + 2) % 4] >> 16) & 0xff] << 16) | (sbox[s[(c + 3) % 4] >> 24] << 24)) ^ this->rk[40 + c];
+            std::memcpy(out, t, sizeof(t));
+        }
+};
+
+#ifdef AES_HAS_ARM_CE
+
+// ARMv8 Crypto Extensions, 4 blocks in flight to hide the latency of the AES instructions
+class ArmCeCtr: public impl::CtrMode<ArmCeCtr> {
+    public:
+        constexpr static auto name = "armv8-ce";
+
+    private:
+        std::array<uint8x16_t, 11> rk;
+
+    public:
+        ArmCeCtr(const Block &key, const Block &ctr) {
+            auto keys = impl::expand_key(key);
+            for (std::size_t i = 0; i < keys.size(); ++i)
+                this->rk[i] = vld1q_u8(keys[i].data());
+            this->reset(ctr);
+        }
+
+        void crypt_blocks(std::uint8_t *dst, const std::uint8_t *src, std::size_t count) {
+            for (; count >= 4; count -= 4, dst += 0x40, src += 0x40) {
+                uint8x16_t b[4];
+                for (auto i = 0; i < 4; ++i)
+                    b[i] = this->next_ctr();
+                for (auto r = 0; r < 9; ++r)
+                    for (auto i = 0; i < 4; ++i)
+                        b[i] = vaesmcq_u8(vaeseq_u8(b[i], this->rk[r]));
+                for (auto i = 0; i < 4; ++i) {
+                    b[i] = veorq_u8(vaeseq_u8(b[i], this->rk[9]), this->rk[10]);
+                    vst1q_u8(dst + 0x10 * i, veorq_u8(b[i], vld1q_u8(src + 0x10 * i)));
+                }
+            }
+
+            for (; count; --count, dst += 0x10, src += 0x10) {
+                auto b = this->next_ctr();
+                for (auto r = 0; r < 9; ++r)
+                    b = vaesmcq_u8(vaeseq_u8(b, this->rk[r]));
+                b = veorq_u8(vaeseq_u8(b, this->rk[9]), this->rk[10]);
+                vst1q_u8(dst, veorq_u8(b, vld1q_u8(src)));
+            }
+        }
+
+    private:
+        inline uint8x16_t next_ctr() {
+            auto res = vld1q_u8(this->ctr.data());
+            impl::increment(this->ctr);
+            return res;
+        }
+};
+
+#endif // AES_HAS_ARM_CE
+
+#ifdef AES_HAS_AES_NI
+
+inline bool aes_ni_supported() {
+    return __builtin_cpu_supports("aes");
+}
+
+// AES-NI, 4 blocks in flight to hide the latency of the AES instructions.
+// Only construct it when aes_ni_supported() returns true
+class AesNiCtr: public impl::CtrMode<AesNiCtr> {
+    public:
+        constexpr static auto name = "aes-ni";
+
+    private:
+        __m128i rk[11];
+
+    public:
+        AES_NI_TARGET AesNiCtr(const Block &key, const Block &ctr) {
+            auto keys = impl::expand_key(key);
+            for (std::size_t i = 0; i < keys.size(); ++i)
+                this->rk[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys[i].data()));
+            this->reset(ctr);
+        }
+
+        AES_NI_TARGET void crypt_blocks(std::uint8_t *dst, const std::uint8_t *src, std::size_t count) {
+            auto *d = reinterpret_cast<__m128i *>(dst);
+            auto *s = reinterpret_cast<const __m128i *>(src);
+
+            for (; count >= 4; count -= 4, d += 4, s += 4) {
+                __m128i b[4];
+                for (auto i = 0; i < 4; ++i)
+                    b[i] = _mm_xor_si128(this->next_ctr(), this->rk[0]);
+                for (auto r = 1; r < 10; ++r)
+                    for (auto i = 0; i < 4; ++i)
+                        b[i] = _mm_aesenc_si128(b[i], this->rk[r]);
+                for (auto i = 0; i < 4; ++i)
+                    _mm_storeu_si128(d + i, _mm_xor_si128(_mm_aesenclast_si128(b[i], this->rk[10]), _mm_loadu_si128(s + i)));
+            }
+
+            for (; count; --count, ++d, ++s) {
+                auto b = _mm_xor_si128(this->next_ctr(), this->rk[0]);
+                for (auto r = 1; r < 10; ++r)
+                    b = _mm_aesenc_si128(b, this->rk[r]);
+                _mm_storeu_si128(d, _mm_xor_si128(_mm_aesenclast_si128(b, this->rk[10]), _mm_loadu_si128(s)));
+            }
+        }
+
+    private:
+        AES_NI_TARGET inline __m128i next_ctr() {
+            auto res = _mm_loadu_si128(reinterpret_cast<const __m128i *>(this->ctr.data()));
+            impl::increment(this->ctr);
+            return res;
+        }
+};
+
+#endif // AES_HAS_AES_NI
+
+#ifdef __SWITCH__
+
+// libnx implementation, which already makes use of the crypto extensions
+class LibnxCtr {
+    public:
+        constexpr static auto name = "libnx";
+
+    private:
+        Aes128CtrContext ctx;
+
+    public:
+        LibnxCtr(const Block &key, const Block &ctr) {
+            aes128CtrContextCreate(&this->ctx, key.data(), ctr.data());
+        }
+
+        inline void reset(const Block &ctr) {
+            aes128CtrContextResetCtr(&this->ctx, ctr.data());
+        }
+
+        inline void crypt(void *dst, const void *src, std::size_t size) {
+            aes128CtrCrypt(&this->ctx, dst, src, size);
+        }
+};
+
+using Ctr = LibnxCtr;
+#elif defined(AES_HAS_ARM_CE)
+using Ctr = ArmCeCtr;
+#elif defined(AES_HAS_AES_NI) && defined(__AES__)
+using Ctr = AesNiCtr;
+#else
+using Ctr = SoftCtr;
+#endif
+
+} // namespace aes
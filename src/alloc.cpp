@@ -0,0 +1,169 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include "alloc.hpp"
+
+// Only debug builds count allocations, release builds keep the toolchain's allocation functions
+#ifdef DEBUG
+
+namespace al {
+
+namespace {
+
+std::atomic_size_t allocs = 0, frees = 0, bytes = 0;
+std::atomic_size_t imgui_allocs = 0, imgui_frees = 0;
+
+std::atomic_bool   trace_enabled = false;
+std::atomic_size_t trace_count   = 0;
+std::array<Trace::Entry, Trace::capacity> trace_entries;
+
+inline void record(void *caller, std::size_t size) {
+    allocs.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    if (trace_enabled.load(std::memory_order_relaxed))
+        trace_entries[trace_count.fetch_add(1, std::memory_order_relaxed) % Trace::capacity] = { caller, size };
+}
+
+inline void *allocate(void *caller, std::size_t size, std::size_t align = 0) {
+    record(caller, size);
+    if (align > alignof(std::max_align_t))
+        return std::aligned_alloc(align, (size + align - 1) & ~(align - 1));
+    return std::malloc(size ? size : 1);
+}
+
+inline void deallocate(void *ptr) {
+    if (!ptr)
+        return;
+    frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(ptr);
+}
+
+} // namespace
+
+Stats get_stats() {
+    return {
+        allocs.load(std::memory_order_relaxed),       frees.load(std::memory_order_relaxed), bytes.load(std::memory_order_relaxed),
+        imgui_allocs.load(std::memory_order_relaxed), imgui_frees.load(std::memory_order_relaxed),
+    };
+}
+
+void enable_trace(bool enable) {
+    trace_enabled.store(enable, std::memory_order_relaxed);
+}
+
+Trace get_trace() {
+    Trace trace = {};
+    trace.count = trace_count.exchange(0, std::memory_order_relaxed);
+    auto first  = (trace.count > Trace::capacity) ? trace.count - Trace::capacity : 0;
+    for (auto i = first; i < trace.count; ++i)
+        trace.entries[i - first] = trace_entries[i % Trace::capacity];
+    return trace;
+}
+
+void *imgui_alloc(std::size_t size, void *) {
+    imgui_allocs.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    if (trace_enabled.load(std::memory_order_relaxed))
+        trace_entries[trace_count.fetch_add(1, std::memory_order_relaxed) % Trace::capacity] = { __builtin_return_address(0), size };
+    return std::malloc(size);
+}
+
+void imgui_free(void *ptr, void *) {
+    if (!ptr)
+        return;
+    imgui_frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(ptr);
+}
+
+void report(const FrameCounter &counter, const Stats &stats) {
+    auto trace = get_trace();
+    if (!stats.total())
+        return;
+
+    std::printf("Frame %lu: %zu allocations (%zu from ImGui), %zu frees, %zu bytes\n", counter.get_frame(),
+        stats.total(), stats.imgui_allocs, stats.frees + stats.imgui_frees, stats.bytes);
+    for (std::size_t i = 0; i < std::min(trace.count, Trace::capacity); ++i)
+        std::printf("    %#zx bytes from %p\n", trace.entries[i].size, trace.entries[i].caller);
+}
+
+} // namespace al
+
+// Replacements of the global allocation functions, so that every form goes through the counters
+void *operator new(std::size_t size) {
+    return al::allocate(__builtin_return_address(0), size);
+}
+
+void *operator new[](std::size_t size) {
+    return al::allocate(__builtin_return_address(0), size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return al::allocate(__builtin_return_address(0), size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return al::allocate(__builtin_return_address(0), size);
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    return al::allocate(__builtin_return_address(0), size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align) {
+    return al::allocate(__builtin_return_address(0), size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *ptr) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+    al::deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+    al::deallocate(ptr);
+}
+
+#endif // DEBUG
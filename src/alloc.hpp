@@ -0,0 +1,91 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+namespace al {
+
+struct Stats {
+    std::size_t allocs = 0, frees = 0, bytes = 0;
+    std::size_t imgui_allocs = 0, imgui_frees = 0;
+
+    constexpr Stats operator -(const Stats &other) const {
+        return {
+            this->allocs       - other.allocs,       this->frees       - other.frees, this->bytes - other.bytes,
+            this->imgui_allocs - other.imgui_allocs, this->imgui_frees - other.imgui_frees,
+        };
+    }
+
+    constexpr std::size_t total() const {
+        return this->allocs + this->imgui_allocs;
+    }
+};
+
+// Last allocations made, with the address of their caller
+struct Trace {
+    static constexpr std::size_t capacity = 16;
+
+    struct Entry {
+        void        *caller;
+        std::size_t  size;
+    };
+
+    std::array<Entry, capacity> entries;
+    std::size_t                 count;
+};
+
+// Counters of every operator new/delete and ImGui allocation since startup, only defined in debug builds
+Stats get_stats();
+
+// The trace ring is only filled while enabled
+void enable_trace(bool enable);
+Trace get_trace();
+
+// To be registered through ImGui::SetAllocatorFunctions before the context is created
+void *imgui_alloc(std::size_t size, void *user);
+void  imgui_free(void *ptr, void *user);
+
+// Allocations made during a frame, to be reported after rendering
+class FrameCounter {
+    private:
+        Stats         start = {};
+        std::uint64_t frame = 0;
+
+    public:
+        inline void begin() {
+            this->start = get_stats();
+        }
+
+        inline Stats end() {
+            ++this->frame;
+            return get_stats() - this->start;
+        }
+
+        inline std::uint64_t get_frame() const {
+            return this->frame;
+        }
+};
+
+// Prints the frame allocations and the trace ring when the frame was not allocation-free
+void report(const FrameCounter &counter, const Stats &stats);
+
+} // namespace al
@@ -0,0 +1,207 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "aes.hpp"
+#include "crypt.hpp"
+#include "sead.hpp"
+
+#include "bench.hpp"
+
+namespace bench {
+
+namespace {
+
+constexpr std::size_t save_size = 0xc00000;
+
+// Same contents for every run, so the outputs of the backends can be compared
+std::vector<std::uint8_t> make_synthetic_save() {
+    auto rng = sead::Random(0x5eed);
+    std::vector<std::uint8_t> res(save_size);
+    for (std::size_t i = 0; i < res.size(); i += sizeof(std::uint32_t)) {
+        auto v = rng.get_u32();
+        std::copy_n(reinterpret_cast<std::uint8_t *>(&v), sizeof(v), &res[i]);
+    }
+    return res;
+}
+
+template <typename Backend>
+void aes_ctr(const std::vector<std::uint8_t> &save, std::vector<std::uint8_t> &reference) {
+    constexpr auto rounds = 4;
+
+    auto key = aes::Block{}, ctr = aes::Block{};
+    auto rng = sead::Random(0xae5);
+    for (std::size_t i = 0; i < key.size(); ++i)
+        key[i] = rng.get_u32() >> 24, ctr[i] = rng.get_u32() >> 24;
+
+    std::vector<std::uint8_t> out(save.size());
+    auto ctx = Backend(key, ctr);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < rounds; ++i) {
+        ctx.reset(ctr);
+        ctx.crypt(out.data(), save.data(), save.size());
+    }
+    auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (reference.empty())
+        reference = out;
+
+    printf("  %-10s %6.3f GB/s%s\n", Backend::name, rounds * save.size() / secs / 1e9,
+        (out == reference) ? "" : " (MISMATCH)");
+}
+
+// Stands in for the save file, so the decryption path can be timed without the filesystem
+struct MemoryFile {
+    const std::vector<std::uint8_t> &data;
+
+    std::size_t read(void *buf, std::size_t size, std::size_t offset) const {
+        auto count = (offset < this->data.size()) ? std::min(size, this->data.size() - offset) : 0;
+        std::copy_n(this->data.data() + offset, count, static_cast<std::uint8_t *>(buf));
+        return count;
+    }
+};
+
+template <typename Backend>
+void decrypt_path(const std::vector<std::uint8_t> &save, const std::vector<std::uint8_t> &encrypted,
+        const aes::Block &key, const aes::Block &ctr) {
+    constexpr auto rounds = 4;
+
+    auto file = MemoryFile{encrypted};
+    std::vector<std::uint8_t> out(save.size());
+
+    auto time = [&](auto &&f) {
+        auto start = std::chrono::steady_clock::now();
+        auto ok = true;
+        for (auto i = 0; i < rounds; ++i)
+            ok &= (f() == out.size()) && (out == save);
+        return std::make_pair(rounds * save.size() / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 1e9, ok);
+    };
+
+    auto [pipelined, pipelined_ok] = time([&] { return sv::decrypt<Backend>(file, out.data(), out.size(), key, ctr); });
+    auto [parallel, parallel_ok]   = time([&] { return sv::decrypt_parallel<Backend>(file, out.data(), out.size(), key, ctr); });
+
+    printf("  %-10s %6.3f GB/s pipelined, %6.3f GB/s parallel%s\n", Backend::name, pipelined, parallel,
+        (pipelined_ok && parallel_ok) ? "" : " (MISMATCH)");
+}
+
+constexpr std::size_t num_streams = 0x100000, outputs_per_stream = 32;
+
+template <std::size_t Lanes>
+std::uint32_t random_streams() {
+    std::uint32_t checksum = 0;
+    if constexpr (Lanes == 1) {
+        for (std::uint32_t seed = 0; seed < num_streams; ++seed) {
+            auto rng = sead::Random(seed);
+            for (std::size_t i = 0; i < outputs_per_stream; ++i)
+                checksum ^= rng.get_u32();
+        }
+    } else {
+        typename sead::RandomN<Lanes>::Vector acc = {};
+        for (std::uint32_t seed = 0; seed < num_streams; seed += Lanes) {
+            auto rng = sead::RandomN<Lanes>(seed);
+            for (std::size_t i = 0; i < outputs_per_stream; ++i)
+                acc ^= rng.get_u32();
+        }
+        for (std::size_t i = 0; i < Lanes; ++i)
+            checksum ^= acc[i];
+    }
+    return checksum;
+}
+
+template <std::size_t Lanes>
+void random_lanes(std::uint32_t &reference) {
+    auto start = std::chrono::steady_clock::now();
+    auto checksum = random_streams<Lanes>();
+    auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (Lanes == 1)
+        reference = checksum;
+
+    printf("  %2lu lane(s) %8.3f M streams/s%s\n", Lanes, num_streams / secs / 1e6,
+        (checksum == reference) ? "" : " (MISMATCH)");
+}
+
+} // namespace
+
+void aes() {
+    printf("AES-128-CTR over a %#lx bytes synthetic save:\n", save_size);
+
+    auto save = make_synthetic_save();
+    std::vector<std::uint8_t> reference;
+
+    aes_ctr<aes::SoftCtr>(save, reference);
+#ifdef AES_HAS_ARM_CE
+    aes_ctr<aes::ArmCeCtr>(save, reference);
+#endif
+#ifdef AES_HAS_AES_NI
+    if (aes::aes_ni_supported())
+        aes_ctr<aes::AesNiCtr>(save, reference);
+#endif
+#ifdef __SWITCH__
+    aes_ctr<aes::LibnxCtr>(save, reference);
+#endif
+}
+
+void decrypt() {
+    printf("sv::decrypt over a %#lx bytes synthetic save, on %lu thread(s):\n", save_size, par::core_count());
+
+    auto save = make_synthetic_save();
+
+    auto key = aes::Block{}, ctr = aes::Block{};
+    auto rng = sead::Random(0xdec);
+    for (std::size_t i = 0; i < key.size(); ++i)
+        key[i] = rng.get_u32() >> 24, ctr[i] = rng.get_u32() >> 24;
+
+    std::vector<std::uint8_t> encrypted(save.size());
+    aes::SoftCtr(key, ctr).crypt(encrypted.data(), save.data(), save.size());
+
+    decrypt_path<aes::SoftCtr>(save, encrypted, key, ctr);
+#ifdef AES_HAS_ARM_CE
+    decrypt_path<aes::ArmCeCtr>(save, encrypted, key, ctr);
+#endif
+#ifdef AES_HAS_AES_NI
+    if (aes::aes_ni_supported())
+        decrypt_path<aes::AesNiCtr>(save, encrypted, key, ctr);
+#endif
+#ifdef __SWITCH__
+    decrypt_path<aes::LibnxCtr>(save, encrypted, key, ctr);
+#endif
+}
+
+void random() {
+    printf("sead::Random, %#lx streams of %lu outputs:\n", num_streams, outputs_per_stream);
+
+    std::uint32_t reference = 0;
+    random_lanes<1>(reference);
+    random_lanes<4>(reference);
+    random_lanes<8>(reference);
+    random_lanes<16>(reference);
+}
+
+void run_all() {
+    aes();
+    decrypt();
+    random();
+}
+
+} // namespace bench
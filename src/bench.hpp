@@ -0,0 +1,30 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+namespace bench {
+
+// Micro-benchmarks of the hot paths, printed to stdout. Built in when BENCHMARK is defined,
+// and on the host as the bench tool
+void aes();
+void decrypt();
+void random();
+
+void run_all();
+
+} // namespace bench
@@ -0,0 +1,302 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aes.hpp"
+#include "parallel.hpp"
+#include "sead.hpp"
+
+// Key derivation and bulk decryption of the save files. Kept free of the filesystem wrappers so it can be built
+// and benchmarked off-console: the decryption takes any file type with a read(buf, size, offset) method,
+// and the AES backend as a template parameter
+
+namespace sv {
+
+// From NHSE
+inline std::array<std::uint8_t, 0x10> get_param(const std::vector<std::uint32_t> &crypt_data, std::size_t idx) {
+    auto sead = sead::Random(crypt_data[crypt_data[idx] & 0x7f]);
+    auto roll_count = (crypt_data[crypt_data[idx + 1] & 0x7f] & 0xf) + 1;
+
+    sead.discard(2 * roll_count);
+
+    std::array<std::uint8_t, 0x10> res;
+    for (std::size_t i = 0; i < res.size(); i++)
+        res[i] = sead.get_u32() >> 24;
+    return res;
+}
+
+inline std::pair<std::array<std::uint8_t, 0x10>, std::array<std::uint8_t, 0x10>> get_keys(const std::vector<std::uint32_t> &crypt_data) {
+    auto key = get_param(crypt_data, 0);
+    auto ctr = get_param(crypt_data, 2);
+    return {std::move(key), std::move(ctr)};
+}
+
+// AES-CTR counters are 128-bit big-endian integers incremented once per block,
+// so the counter for any block-aligned offset can be computed directly
+inline std::array<std::uint8_t, 0x10> ctr_at(std::array<std::uint8_t, 0x10> ctr, std::size_t offset) {
+    std::uint64_t carry = offset / 0x10;
+    for (std::size_t i = ctr.size(); (i > 0) && carry; --i) {
+        carry += ctr[i - 1];
+        ctr[i - 1] = carry & 0xff;
+        carry >>= 8;
+    }
+    return ctr;
+}
+
+struct DecryptOptions {
+    std::size_t chunk_size  = 0x80000; // 512 KiB, rounded to the AES block size
+    std::size_t queue_depth = 3;       // Chunks the reader can get ahead of the decryption
+};
+
+// Time spent in each stage of the pipeline, and time each stage spent stalled on the other
+struct CryptStats {
+    std::uint64_t io_ns    = 0, io_wait_ns    = 0;
+    std::uint64_t crypt_ns = 0, crypt_wait_ns = 0;
+    std::uint64_t total_ns = 0;
+
+    inline void print(const char *what) const {
+        printf("%s took %.2fms: io %.2fms (stalled %.2fms), crypto %.2fms (stalled %.2fms)\n", what,
+            total_ns / 1e6, io_ns / 1e6, io_wait_ns / 1e6, crypt_ns / 1e6, crypt_wait_ns / 1e6);
+    }
+};
+
+namespace impl {
+
+inline std::uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Default-initializes instead of value-initializing, so resizing a byte buffer doesn't zero it
+template <typename T>
+struct UninitAllocator: std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = UninitAllocator<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template <typename U>
+    void construct(U *ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void *>(ptr)) U;
+    }
+
+    template <typename U, typename ...Args>
+    void construct(U *ptr, Args &&...args) {
+        ::new (static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
+} // namespace impl
+
+// Decrypted data, left uninitialized on allocation since it is about to be overwritten
+using Buffer = std::vector<std::uint8_t, impl::UninitAllocator<std::uint8_t>>;
+
+// Ciphertext is read straight into the destination and decrypted in place. Reads are done on a separate thread,
+// which runs up to `queue_depth` chunks ahead of the decryption. Returns the number of bytes decrypted
+template <typename Backend = aes::Ctr, typename File>
+std::size_t decrypt(File &main, std::uint8_t *dst, std::size_t size,
+        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr,
+        const DecryptOptions &options = {}, CryptStats *stats = nullptr) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto ctx = Backend(key, ctr);
+
+    auto chunk_size  = std::max(options.chunk_size & ~0xful, 0x10ul);
+    auto queue_depth = std::max(options.queue_depth, 1ul);
+
+    struct Chunk {
+        std::size_t offset = 0, size = 0;
+    };
+
+    std::vector<Chunk> chunks(queue_depth);
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::size_t num_read = 0, num_decrypted = 0, total = 0;
+    bool read_done = false;
+    CryptStats st = {};
+
+    auto reader = std::thread([&] {
+        for (std::size_t offset = 0, i = 0; offset < size; ++i) {
+            auto wait_start = std::chrono::steady_clock::now();
+            {
+                std::unique_lock lk(mtx);
+                cv.wait(lk, [&] { return num_read - num_decrypted < queue_depth; });
+            }
+            st.io_wait_ns += impl::elapsed_ns(wait_start);
+
+            auto read_start = std::chrono::steady_clock::now();
+            auto want    = std::min(chunk_size, size - offset);
+            auto &chunk  = chunks[i % queue_depth];
+            chunk.offset = offset;
+            chunk.size   = main.read(dst + offset, want, offset);
+            st.io_ns  += impl::elapsed_ns(read_start);
+
+            offset += chunk.size;
+            bool is_last = (chunk.size != want) || (offset >= size);
+
+            {
+                std::lock_guard lk(mtx);
+                ++num_read;
+                read_done = is_last;
+            }
+            cv.notify_all();
+
+            if (is_last)
+                break;
+        }
+
+        std::lock_guard lk(mtx);
+        read_done = true;
+        cv.notify_all();
+    });
+
+    for (std::size_t i = 0;; ++i) {
+        auto wait_start = std::chrono::steady_clock::now();
+        {
+            std::unique_lock lk(mtx);
+            cv.wait(lk, [&] { return (num_read > i) || read_done; });
+            if (num_read <= i)
+                break;
+        }
+        st.crypt_wait_ns += impl::elapsed_ns(wait_start);
+
+        auto crypt_start = std::chrono::steady_clock::now();
+        auto &chunk = chunks[i % queue_depth];
+        ctx.crypt(dst + chunk.offset, dst + chunk.offset, chunk.size);
+        total       += chunk.size;
+        st.crypt_ns += impl::elapsed_ns(crypt_start);
+
+        {
+            std::lock_guard lk(mtx);
+            ++num_decrypted;
+        }
+        cv.notify_all();
+    }
+
+    reader.join();
+
+    st.total_ns = impl::elapsed_ns(start);
+    if (stats)
+        *stats = st;
+
+    return total;
+}
+
+template <typename Backend = aes::Ctr, typename File>
+Buffer decrypt(File &main, std::size_t size,
+        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr,
+        const DecryptOptions &options = {}, CryptStats *stats = nullptr) {
+    Buffer res(size);
+    res.resize(decrypt<Backend>(main, res.data(), res.size(), key, ctr, options, stats));
+    return res;
+}
+
+// Each thread reads and decrypts its own slice of the destination in place,
+// with the counter advanced to the start of the slice. Returns the size of the decrypted prefix,
+// which ends at the first short read even if later slices were read in full
+template <typename Backend = aes::Ctr, typename File>
+std::size_t decrypt_parallel(File &main, std::uint8_t *dst, std::size_t size,
+        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr,
+        std::size_t num_threads = par::core_count(), CryptStats *stats = nullptr) {
+    // Decrypt in chunks so the data is still in cache after being read
+    constexpr std::size_t chunk_size = 0x80000; // 512 KiB
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::atomic_uint64_t read_ns = 0, crypt_ns = 0;
+    std::atomic_size_t total = size;
+
+    par::for_slices(size, num_threads, chunk_size, [&](std::size_t begin, std::size_t end, std::size_t) {
+        auto ctx = Backend(key, ctr_at(ctr, begin));
+
+        for (auto offset = begin; offset < end;) {
+            auto read_start = std::chrono::steady_clock::now();
+            auto want = std::min(chunk_size, end - offset);
+            auto read = main.read(dst + offset, want, offset);
+            read_ns += impl::elapsed_ns(read_start);
+
+            auto crypt_start = std::chrono::steady_clock::now();
+            ctx.crypt(dst + offset, dst + offset, read);
+            crypt_ns += impl::elapsed_ns(crypt_start);
+
+            offset += read;
+            if (read != want) {
+                for (auto cur = total.load(); (offset < cur) && !total.compare_exchange_weak(cur, offset);)
+                    ;
+                break;
+            }
+        }
+    });
+
+    if (stats)
+        *stats = { read_ns, 0, crypt_ns, 0, impl::elapsed_ns(start) };
+
+    return total;
+}
+
+template <typename Backend = aes::Ctr, typename File>
+Buffer decrypt_parallel(File &main, std::size_t size,
+        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr,
+        std::size_t num_threads = par::core_count(), CryptStats *stats = nullptr) {
+    Buffer res(size);
+    res.resize(decrypt_parallel<Backend>(main, res.data(), res.size(), key, ctr, num_threads, stats));
+    return res;
+}
+
+constexpr std::size_t header_size = 0x300;
+
+// Header of an encrypted file: version info, followed by the data the key and counter are derived from
+struct Header {
+    std::array<std::uint8_t, header_size> data;
+    std::array<std::uint8_t, 0x10>        key, ctr;
+};
+
+// From NHSE, the game fills the encryption data with a freshly seeded sead::Random every time it saves
+inline Header generate_header(std::uint32_t seed, const std::array<std::uint8_t, 0x100> &version_data) {
+    auto sead = sead::Random(seed);
+    std::vector<std::uint32_t> crypt_data(0x80);
+    for (auto &v: crypt_data)
+        v = sead.get_u32();
+
+    Header header;
+    std::copy(version_data.begin(), version_data.end(), header.data.begin());
+    std::copy_n(reinterpret_cast<const std::uint8_t *>(crypt_data.data()), crypt_data.size() * sizeof(std::uint32_t),
+        header.data.begin() + version_data.size());
+    std::tie(header.key, header.ctr) = get_keys(crypt_data);
+    return header;
+}
+
+} // namespace sv
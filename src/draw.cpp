@@ -0,0 +1,178 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cfloat>
+#include <cstdint>
+#include <imgui.h>
+
+#include "gui.hpp"
+#include "lang.hpp"
+#include "theme.hpp"
+
+// Contents of the frame, kept apart from the renderer so they can run headless on the host
+
+namespace gui {
+
+Actions draw_main_window(const vm::Views &views) {
+    Actions actions = {};
+    auto &main_view = views.get_main();
+    auto &[width, height] = im::GetIO().DisplaySize;
+
+    im::SetNextWindowFocus();
+    im::Begin(main_view.title.data(), nullptr,
+        ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoMove);
+    im::SetWindowPos({0.23f * width, 0.16f * height});
+    im::SetWindowSize({0.55f * width, 0.73f * height});
+
+    im::TextUnformatted(main_view.last_save.data());
+    if (main_view.is_outdated)
+        im::SameLine(), gui::do_with_color(th::text_min_col, [&] { im::TextUnformatted(main_view.outdated.data()); });
+
+    if (main_view.can_check)
+        actions.check_save = im::Button(main_view.check.data());
+    if (main_view.check_status[0])
+        im::SameLine(), im::TextUnformatted(main_view.check_status.data());
+
+    im::BeginTabBar("##tab_bar", ImGuiTabBarFlags_NoTooltip);
+
+    draw_turnip_tab(views.get_turnips());
+    draw_visitor_tab(views.get_visitors());
+    draw_weather_tab(views.get_weather());
+    actions.language_changed = draw_language_tab(views.get_language());
+
+    im::EndTabBar();
+
+    im::End();
+    return actions;
+}
+
+void draw_turnip_tab(const vm::TurnipView &view) {
+    if (!im::BeginTabItem(view.tab.data()))
+        return;
+
+    im::TextUnformatted(view.header.data());
+
+    if (view.has_next_odds) {
+        im::TextUnformatted(view.next_week.data());
+        for (auto &odds: view.next_odds)
+            im::SameLine(), im::TextUnformatted(odds.data());
+    }
+
+    im::BeginTable("##Prices table", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
+    im::TableNextRow();
+    im::TableNextCell(), im::TextUnformatted(view.am.data());
+    im::TableNextCell(), im::TextUnformatted(view.pm.data());
+
+    for (std::uint32_t day = 0; day < view.days.size(); ++day) {
+        im::TableNextRow(); im::TextUnformatted(view.days[day].data());
+        do_with_color(view.colors[2 * day],     [&] { im::TableNextCell(), im::TextUnformatted(view.prices[2 * day].data()); });
+        do_with_color(view.colors[2 * day + 1], [&] { im::TableNextCell(), im::TextUnformatted(view.prices[2 * day + 1].data()); });
+    }
+    im::EndTable();
+
+    im::Separator();
+    do_with_color(view.max_color, [&] { im::TextUnformatted(view.max.data()); }); im::SameLine();
+    do_with_color(view.min_color, [&] { im::TextUnformatted(view.min.data()); }); im::SameLine();
+    im::TextUnformatted(view.average.data());
+
+    im::Separator();
+    im::TextUnformatted(view.graph.data());
+    im::PlotLines("##Graph", view.plot.data(), view.plot.size(),
+        0, "", FLT_MAX, FLT_MAX, {im::GetWindowWidth() - 30.0f, 125.0f});
+
+    // Exact bounds on hover, the bands are wide enough already
+    im::Separator();
+    im::TextUnformatted(view.next_prices.data());
+    im::BeginTable("##Next week table", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
+    im::TableNextRow();
+    im::TableNextCell(), im::TextUnformatted(view.am.data());
+    im::TableNextCell(), im::TextUnformatted(view.pm.data());
+
+    for (std::uint32_t day = 1; day < view.days.size(); ++day) {
+        im::TableNextRow(); im::TextUnformatted(view.days[day].data());
+        for (auto half: { 2 * day - 2, 2 * day - 1 }) {
+            im::TableNextCell(), im::TextUnformatted(view.next_bands[half].data());
+            if (im::IsItemHovered())
+                im::SetTooltip("%s", view.next_bounds[half].data());
+        }
+    }
+    im::EndTable();
+
+    im::EndTabItem();
+}
+
+void draw_visitor_tab(const vm::VisitorView &view) {
+    if (!im::BeginTabItem(view.tab.data()))
+        return;
+
+    im::Dummy(ImVec2(0.0f, 10.0f));
+    im::BeginTable("##Visitors table", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
+
+    auto print_day = [&](std::uint32_t day) -> void {
+        im::TableNextCell(); im::TextUnformatted(view.days[day].data());
+        do_with_color(view.colors[day], [&] {
+            im::TableNextCell(), im::TextUnformatted(view.names[day].data());
+            if (day == view.celeste_day)
+                im::SameLine(), im::TextUnformatted(view.celeste.data());
+            if (day == view.wisp_day)
+                im::SameLine(), im::TextUnformatted(view.wisp.data());
+        });
+    };
+
+    print_day(1); print_day(2); print_day(3);
+    print_day(4); print_day(5); print_day(6);
+    print_day(0);
+    im::EndTable();
+
+    im::EndTabItem();
+}
+
+void draw_weather_tab(const vm::WeatherView &view) {
+    if (!im::BeginTabItem(view.tab.data()))
+        return;
+
+    im::Dummy(ImVec2(0.0f, 10.0f));
+    im::TextUnformatted(view.hemisphere.data());
+    im::TextUnformatted(view.seed.data());
+
+    im::Separator();
+    im::TextUnformatted(view.tip.data());
+
+    im::EndTabItem();
+}
+
+bool draw_language_tab(const vm::LanguageView &view) {
+    if (!im::BeginTabItem(view.tab.data()))
+        return false;
+
+    auto cur_lang = lang::get_current_language(), prev_lang = cur_lang;
+    for (std::size_t i = 0; i < lang::language_names.size(); ++i)
+        im::RadioButton(lang::language_names[i], reinterpret_cast<int *>(&cur_lang), static_cast<int>(i));
+
+    bool changed = cur_lang != prev_lang;
+    if (changed)
+        lang::set_language(cur_lang);
+
+    im::Separator();
+    im::TextUnformatted("If you'd like to see your language here, make an issue on\nhttps://github.com/averne/Turnips");
+
+    im::EndTabItem();
+    return changed;
+}
+
+} // namespace gui
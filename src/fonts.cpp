@@ -0,0 +1,264 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "fs.hpp"
+#include "hash.hpp"
+
+#include "fonts.hpp"
+
+namespace ft {
+
+namespace {
+
+constexpr std::array<char, 4> cache_magic = { 'T', 'F', 'N', 'T' };
+
+// Followed by the glyphs, the alpha8 texture, then the baked line coordinates if this version of ImGui has them.
+// The payload hash chains the three parts
+struct CacheHeader {
+    std::array<char, 4> magic;
+    std::uint32_t       key;
+    std::uint32_t       payload_hash;
+    std::uint32_t       tex_width, tex_height;
+    std::uint32_t       num_glyphs;
+    float               font_size, ascent, descent;
+    ImWchar             fallback_char, ellipsis_char;
+    ImVec2              uv_white_pixel;
+};
+
+#ifdef IM_DRAWLIST_TEX_LINES_WIDTH_MAX
+constexpr std::size_t uv_lines_size = sizeof(ImFontAtlas::TexUvLines);
+#else
+constexpr std::size_t uv_lines_size = 0;
+#endif
+
+constexpr std::size_t get_file_size(const CacheHeader &header) {
+    return sizeof(header) + header.num_glyphs * sizeof(ImFontGlyph) + header.tex_width * header.tex_height + uv_lines_size;
+}
+
+// Only the atlas just saved is kept. The others were built for another language, or from other fonts or another
+// version of ImGui, and would otherwise pile up in the cache directory
+void delete_other_atlases(fs::Filesystem &sd, const std::string &path) {
+    auto sep = path.rfind('/');
+    auto dir = path.substr(0, sep), name = path.substr(sep + 1);
+
+    std::vector<std::string> stale;
+    {
+        fs::Directory d;
+        if (R_FAILED(sd.open_directory(d, dir.empty() ? "/" : dir)))
+            return;
+        for (auto &entry: d.list()) {
+            auto is_atlas = (entry.type == FsDirEntryType_File) && (std::strspn(entry.name, "0123456789abcdef") == 8)
+                && !std::strcmp(entry.name + 8, ".bin");
+            if (is_atlas && (name != entry.name))
+                stale.push_back(dir + '/' + entry.name);
+        }
+    }
+
+    for (auto &file: stale)
+        sd.delete_file(file);
+}
+
+template <typename T>
+std::uint32_t hash_value(const T &value, std::uint32_t seed) {
+    return hs::murmur3(reinterpret_cast<const std::uint8_t *>(&value), sizeof(value), seed);
+}
+
+} // namespace
+
+std::uint32_t make_key(const ImFontAtlas &atlas, const std::vector<Source> &sources) {
+    auto key = hash_value(IMGUI_VERSION_NUM, 0);
+    key = hash_value(sizeof(ImFontGlyph), key);
+    key = hash_value(uv_lines_size, key);
+    key = hash_value(atlas.Flags, key);
+    key = hash_value(atlas.TexGlyphPadding, key);
+    for (auto &source: sources) {
+        key = hs::murmur3(static_cast<const std::uint8_t *>(source.data), source.size, key);
+        key = hash_value(source.size_pixels, key);
+        auto *end = source.ranges;
+        while (*end)
+            ++end;
+        key = hs::murmur3(reinterpret_cast<const std::uint8_t *>(source.ranges), (end - source.ranges) * sizeof(ImWchar), key);
+    }
+    return key;
+}
+
+Result load(ImFontAtlas &atlas, std::uint32_t key, const char *path) {
+    auto sd = fs::Filesystem();
+    if (auto rc = sd.open_sdmc(); R_FAILED(rc))
+        return rc;
+
+    if (!sd.is_file(path))
+        return 1;
+
+    fs::File file;
+    if (auto rc = sd.open_file(file, path); R_FAILED(rc))
+        return rc;
+
+    CacheHeader header;
+    if (auto read = file.read(&header, sizeof(header)); read != sizeof(header))
+        return 1;
+    if ((header.magic != cache_magic) || (header.key != key) || (file.size() != get_file_size(header)))
+        return 1;
+
+    // Read everything straight into its final location
+    auto offset = sizeof(header);
+    ImVector<ImFontGlyph> glyphs;
+    glyphs.resize(header.num_glyphs);
+    auto glyphs_size = header.num_glyphs * sizeof(ImFontGlyph);
+    if (auto read = file.read(glyphs.Data, glyphs_size, offset); read != glyphs_size)
+        return 1;
+    auto hash = hs::murmur3(reinterpret_cast<const std::uint8_t *>(glyphs.Data), glyphs_size);
+    offset += glyphs_size;
+
+    auto tex_size = header.tex_width * header.tex_height;
+    auto *pixels  = static_cast<unsigned char *>(IM_ALLOC(tex_size));
+    if (auto read = file.read(pixels, tex_size, offset); read != tex_size) {
+        IM_FREE(pixels);
+        return 1;
+    }
+    hash = hs::murmur3(pixels, tex_size, hash);
+    offset += tex_size;
+
+#ifdef IM_DRAWLIST_TEX_LINES_WIDTH_MAX
+    if (auto read = file.read(atlas.TexUvLines, uv_lines_size, offset); read != uv_lines_size) {
+        IM_FREE(pixels);
+        return 1;
+    }
+    hash = hs::murmur3(reinterpret_cast<const std::uint8_t *>(atlas.TexUvLines), uv_lines_size, hash);
+#endif
+
+    if (hash != header.payload_hash) {
+        IM_FREE(pixels);
+        return 1;
+    }
+
+    auto *font = IM_NEW(ImFont);
+    font->FontSize       = header.font_size;
+    font->Ascent         = header.ascent;
+    font->Descent        = header.descent;
+    font->FallbackChar   = header.fallback_char;
+    font->EllipsisChar   = header.ellipsis_char;
+    font->ContainerAtlas = &atlas;
+    font->Glyphs.swap(glyphs);
+    font->BuildLookupTable();
+
+    atlas.TexPixelsAlpha8 = pixels;
+    atlas.TexWidth        = header.tex_width;
+    atlas.TexHeight       = header.tex_height;
+    atlas.TexUvScale      = ImVec2(1.0f / header.tex_width, 1.0f / header.tex_height);
+    atlas.TexUvWhitePixel = header.uv_white_pixel;
+    atlas.Fonts.push_back(font);
+
+    return 0;
+}
+
+Result save(const ImFontAtlas &atlas, std::uint32_t key, const char *path) {
+    // Only merged atlases are supported
+    if ((atlas.Fonts.Size != 1) || !atlas.TexPixelsAlpha8)
+        return 1;
+
+    auto *font = atlas.Fonts[0];
+    auto header = CacheHeader{
+        cache_magic, key, 0,
+        static_cast<std::uint32_t>(atlas.TexWidth), static_cast<std::uint32_t>(atlas.TexHeight),
+        static_cast<std::uint32_t>(font->Glyphs.Size),
+        font->FontSize, font->Ascent, font->Descent,
+        font->FallbackChar, font->EllipsisChar,
+        atlas.TexUvWhitePixel,
+    };
+
+    auto glyphs_size = header.num_glyphs * sizeof(ImFontGlyph), tex_size = std::size_t(header.tex_width * header.tex_height);
+    header.payload_hash = hs::murmur3(reinterpret_cast<const std::uint8_t *>(font->Glyphs.Data), glyphs_size);
+    header.payload_hash = hs::murmur3(atlas.TexPixelsAlpha8, tex_size, header.payload_hash);
+#ifdef IM_DRAWLIST_TEX_LINES_WIDTH_MAX
+    header.payload_hash = hs::murmur3(reinterpret_cast<const std::uint8_t *>(atlas.TexUvLines), uv_lines_size, header.payload_hash);
+#endif
+
+    auto sd = fs::Filesystem();
+    if (auto rc = sd.open_sdmc(); R_FAILED(rc))
+        return rc;
+
+    auto path_str = std::string(path);
+    for (auto pos = path_str.find('/', 1); pos != std::string::npos; pos = path_str.find('/', pos + 1))
+        sd.create_directory(path_str.substr(0, pos));
+    sd.delete_file(path_str);
+    if (auto rc = sd.create_file(path_str, get_file_size(header)); R_FAILED(rc))
+        return rc;
+
+    fs::File file;
+    if (auto rc = sd.open_file(file, path_str, FsOpenMode_Write); R_FAILED(rc))
+        return rc;
+
+    auto offset = sizeof(header);
+    auto rc = file.write(&header, sizeof(header));
+    rc |= file.write(font->Glyphs.Data, glyphs_size, offset), offset += glyphs_size;
+    rc |= file.write(atlas.TexPixelsAlpha8, tex_size, offset), offset += tex_size;
+#ifdef IM_DRAWLIST_TEX_LINES_WIDTH_MAX
+    rc |= file.write(atlas.TexUvLines, uv_lines_size, offset);
+#endif
+    if (R_FAILED(rc)) {
+        // A partial file would fail the size check anyway, but don't leave it taking up space
+        file.close();
+        sd.delete_file(path_str);
+        return rc;
+    }
+    file.flush();
+    file.close();
+
+    delete_other_atlases(sd, path_str);
+    return 0;
+}
+
+Result build(ImFontAtlas &atlas, const std::vector<Source> &sources, const char *dir) {
+    auto start = std::chrono::steady_clock::now();
+    auto key   = make_key(atlas, sources);
+
+    char path[FS_MAX_PATH];
+    std::snprintf(path, sizeof(path), "%s/%08x.bin", dir, key);
+    if (R_SUCCEEDED(load(atlas, key, path))) {
+        printf("Loaded font atlas (%dx%d) from cache in %.1fms\n", atlas.TexWidth, atlas.TexHeight,
+            std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+        return 0;
+    }
+
+    ImFontConfig font_cfg;
+    font_cfg.FontDataOwnedByAtlas = false;
+    for (auto &source: sources) {
+        atlas.AddFontFromMemoryTTF(const_cast<void *>(source.data), source.size, source.size_pixels, &font_cfg, source.ranges);
+        font_cfg.MergeMode = true;
+    }
+
+    if (!atlas.Build())
+        return 1;
+
+    printf("Built font atlas (%dx%d, %d glyphs) in %.1fms\n", atlas.TexWidth, atlas.TexHeight, atlas.Fonts[0]->Glyphs.Size,
+        std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    if (auto rc = save(atlas, key, path); R_FAILED(rc))
+        printf("Failed to cache font atlas: %#x\n", rc);
+    return 0;
+}
+
+} // namespace ft
@@ -0,0 +1,49 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <imgui.h>
+#include <switch.h>
+
+namespace ft {
+
+struct Source {
+    const void    *data;
+    std::size_t    size;
+    float          size_pixels;
+    const ImWchar *ranges;
+};
+
+// Atlases are cached in this directory, named after their key. Only the last one saved is kept
+constexpr auto cache_dir = "/switch/Turnips/fonts";
+
+// Identifies an atlas built from these sources, along with the layout of the ImGui structures it is stored as
+std::uint32_t make_key(const ImFontAtlas &atlas, const std::vector<Source> &sources);
+
+// The atlas must be empty. Recreates a single font from the cache, without rasterizing anything
+Result load(ImFontAtlas &atlas, std::uint32_t key, const char *path);
+Result save(const ImFontAtlas &atlas, std::uint32_t key, const char *path);
+
+// Merges the sources into a single font, loaded from the cache when its key matches or built and cached otherwise
+Result build(ImFontAtlas &atlas, const std::vector<Source> &sources, const char *dir = cache_dir);
+
+} // namespace ft
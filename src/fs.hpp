@@ -20,10 +20,61 @@
 #include <cstdint>
 #include <string>
 #include <vector>
-#include <switch.h>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#else
+#   include <cstdio>
+#   include <cstring>
+#   include <dirent.h>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#ifndef __SWITCH__
+
+// Stand-ins for the libnx definitions the wrappers expose, for host builds
+using Result = std::uint32_t;
+
+#define R_SUCCEEDED(rc) ((rc) == 0)
+#define R_FAILED(rc)    ((rc) != 0)
+
+#define MAKERESULT(module, description) (((module) & 0x1ff) | (((description) & 0x1fff) << 9))
+
+#define FS_MAX_PATH 0x301
+
+enum FsOpenMode {
+    FsOpenMode_Read   = 1 << 0,
+    FsOpenMode_Write  = 1 << 1,
+    FsOpenMode_Append = 1 << 2,
+};
+
+enum FsDirEntryType {
+    FsDirEntryType_Dir  = 0,
+    FsDirEntryType_File = 1,
+};
+
+struct FsDirectoryEntry {
+    char          name[FS_MAX_PATH];
+    std::uint8_t  pad[3];
+    std::int8_t   type;
+    std::uint8_t  pad2[3];
+    std::int64_t  file_size;
+};
+
+struct FsTimeStampRaw {
+    std::uint64_t created, modified, accessed;
+    std::uint8_t  is_valid;
+    std::uint8_t  pad[7];
+};
+
+#endif // __SWITCH__
 
 namespace fs {
 
+#ifdef __SWITCH__
+
 struct Directory {
     FsDir handle = {};
 
@@ -82,6 +133,7 @@ struct File {
 
     inline void close() {
         fsFileClose(&this->handle);
+        this->handle = {};
     }
 
     inline bool is_open() const {
@@ -106,8 +158,11 @@ struct File {
         return tmp;
     }
 
-    inline void write(const void *buf, std::size_t size, std::size_t offset = 0) {
-        fsFileWrite(&this->handle, static_cast<std::int64_t>(offset), buf, size, FsWriteOption_None);
+    inline Result write(const void *buf, std::size_t size, std::size_t offset = 0) {
+        auto rc = fsFileWrite(&this->handle, static_cast<std::int64_t>(offset), buf, size, FsWriteOption_None);
+        if (R_FAILED(rc))
+            printf("Write failed with %#x\n", rc);
+        return rc;
     }
 
     inline void flush() {
@@ -241,4 +296,208 @@ struct Filesystem {
     }
 };
 
+
+#else
+
+// Host implementation over a directory of the local filesystem, standing in for a mounted device.
+// Paths are relative to that directory, with the same leading slash as on the console
+struct Directory {
+    DIR *handle = nullptr;
+
+    constexpr inline Directory() = default;
+
+    inline ~Directory() {
+        this->close();
+    }
+
+    inline Result open(const std::string &root, const std::string &path) {
+        this->close();
+        this->handle = opendir((root + path).c_str());
+        return this->handle ? 0 : 1;
+    }
+
+    inline void close() {
+        if (this->handle)
+            closedir(this->handle);
+        this->handle = nullptr;
+    }
+
+    inline bool is_open() const {
+        return this->handle;
+    }
+
+    std::vector<FsDirectoryEntry> list() {
+        std::vector<FsDirectoryEntry> entries;
+        if (!this->handle)
+            return entries;
+
+        rewinddir(this->handle);
+        while (auto *ent = readdir(this->handle)) {
+            if ((ent->d_type != DT_DIR) && (ent->d_type != DT_REG))
+                continue;
+            if (!std::strcmp(ent->d_name, ".") || !std::strcmp(ent->d_name, ".."))
+                continue;
+
+            auto &entry = entries.emplace_back();
+            std::memset(&entry, 0, sizeof(entry));
+            std::snprintf(entry.name, sizeof(entry.name), "%s", ent->d_name);
+            entry.type = (ent->d_type == DT_DIR) ? FsDirEntryType_Dir : FsDirEntryType_File;
+        }
+        return entries;
+    }
+
+    inline std::size_t count() {
+        return this->list().size();
+    }
+};
+
+struct File {
+    int fd = -1;
+
+    constexpr inline File() = default;
+
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    inline File(File &&other): fd(other.fd) {
+        other.fd = -1;
+    }
+
+    inline ~File() {
+        this->close();
+    }
+
+    inline Result open(const std::string &root, const std::string &path, std::uint32_t mode = FsOpenMode_Read) {
+        this->close();
+        auto flags = (mode & FsOpenMode_Write) ? ((mode & FsOpenMode_Read) ? O_RDWR : O_WRONLY) : O_RDONLY;
+        this->fd = ::open((root + path).c_str(), flags);
+        return (this->fd >= 0) ? 0 : 1;
+    }
+
+    inline void close() {
+        if (this->fd >= 0)
+            ::close(this->fd);
+        this->fd = -1;
+    }
+
+    inline bool is_open() const {
+        return this->fd >= 0;
+    }
+
+    inline std::size_t size() {
+        struct stat st = {};
+        fstat(this->fd, &st);
+        return st.st_size;
+    }
+
+    inline void size(std::size_t size) {
+        if (ftruncate(this->fd, static_cast<off_t>(size)))
+            printf("Resize failed\n");
+    }
+
+    // Positioned reads and writes, so threads can share the handle like they do on the console
+    inline std::size_t read(void *buf, std::size_t size, std::size_t offset = 0) {
+        std::size_t done = 0;
+        while (done < size) {
+            auto res = pread(this->fd, static_cast<std::uint8_t *>(buf) + done, size - done, static_cast<off_t>(offset + done));
+            if (res <= 0) {
+                if (res < 0)
+                    printf("Read failed\n");
+                break;
+            }
+            done += res;
+        }
+        return done;
+    }
+
+    inline Result write(const void *buf, std::size_t size, std::size_t offset = 0) {
+        std::size_t done = 0;
+        while (done < size) {
+            auto res = pwrite(this->fd, static_cast<const std::uint8_t *>(buf) + done, size - done, static_cast<off_t>(offset + done));
+            if (res <= 0) {
+                printf("Write failed\n");
+                return 1;
+            }
+            done += res;
+        }
+        return 0;
+    }
+
+    inline void flush() {
+        fsync(this->fd);
+    }
+};
+
+struct Filesystem {
+    std::string root;
+
+    inline Filesystem() = default;
+    inline Filesystem(const std::string &root): root(root) { }
+
+    // The SD card is mapped to the working directory
+    inline Result open_sdmc() {
+        this->root = ".";
+        return 0;
+    }
+
+    inline void close() {
+        this->root.clear();
+    }
+
+    inline bool is_open() const {
+        return !this->root.empty();
+    }
+
+    // Writes are not journaled on the host, there is nothing to commit
+    inline Result flush() {
+        return 0;
+    }
+
+    inline Result open_directory(Directory &d, const std::string &path) {
+        return d.open(this->root, path);
+    }
+
+    inline Result open_file(File &f, const std::string &path, std::uint32_t mode = FsOpenMode_Read) {
+        return f.open(this->root, path, mode);
+    }
+
+    inline Result create_directory(const std::string &path) {
+        return mkdir((this->root + path).c_str(), 0755) ? 1 : 0;
+    }
+
+    inline Result create_file(const std::string &path, std::size_t size = 0) {
+        auto fd = ::open((this->root + path).c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+            return 1;
+        auto rc = ftruncate(fd, static_cast<off_t>(size));
+        ::close(fd);
+        return rc ? 1 : 0;
+    }
+
+    inline FsDirEntryType get_path_type(const std::string &path) {
+        struct stat st = {};
+        if (stat((this->root + path).c_str(), &st))
+            return static_cast<FsDirEntryType>(-1);
+        return S_ISDIR(st.st_mode) ? FsDirEntryType_Dir : FsDirEntryType_File;
+    }
+
+    inline bool is_directory(const std::string &path) {
+        return get_path_type(path) == FsDirEntryType_Dir;
+    }
+
+    inline bool is_file(const std::string &path) {
+        return get_path_type(path) == FsDirEntryType_File;
+    }
+
+    inline Result move_file(const std::string &old_path, const std::string &new_path) {
+        return rename((this->root + old_path).c_str(), (this->root + new_path).c_str()) ? 1 : 0;
+    }
+
+    inline Result delete_file(const std::string &path) {
+        return unlink((this->root + path).c_str()) ? 1 : 0;
+    }
+};
+
+#endif // __SWITCH__
+
 } // namespace fs
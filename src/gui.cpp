@@ -18,19 +18,17 @@
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
-#include <numeric>
+#include <string>
+#include <vector>
 #include <switch.h>
 #include <imgui.h>
-#include <stb_image.h>
 #include "imgui_nx/imgui_deko3d.h"
 #include "imgui_nx/imgui_nx.h"
 
+#include "alloc.hpp"
 #include "gui.hpp"
 #include "lang.hpp"
-
-#include "theme.hpp"
-
-using namespace lang::literals;
+#include "texture.hpp"
 
 namespace gui {
 
@@ -69,6 +67,25 @@ dk::ImageDescriptor   *s_imageDescriptors   = nullptr;
 dk::UniqueQueue        s_queue;
 dk::UniqueSwapchain    s_swapchain;
 
+std::vector<ImWchar>   s_glyphRanges;
+std::string            s_background;
+
+// Returns whether the ranges needed by the current language changed
+bool updateGlyphRanges() {
+    std::vector<ImWchar> ranges;
+    for (auto [first, last]: lang::get_glyph_ranges()) {
+        if (first > IM_UNICODE_CODEPOINT_MAX)
+            break;
+        ranges.push_back(first), ranges.push_back(std::min<std::uint32_t>(last, IM_UNICODE_CODEPOINT_MAX));
+    }
+    ranges.push_back(0);
+
+    if (ranges == s_glyphRanges)
+        return false;
+    s_glyphRanges = std::move(ranges);
+    return true;
+}
+
 void rebuildSwapchain(unsigned const width_, unsigned const height_) {
     // destroy old swapchain
     s_swapchain = nullptr;
@@ -195,13 +212,101 @@ void deko3dExit() {
     s_device        = nullptr;
 }
 
+void uploadBackground(dk::UniqueMemBlock &memBlock, std::size_t offset, DkImageFormat format, std::uint32_t w, std::uint32_t h) {
+    // wait for previous commands to complete
+    s_queue.waitIdle();
+
+    dk::ImageLayout layout;
+    dk::ImageLayoutMaker{s_device}
+        .setFlags(0)
+        .setFormat(format)
+        .setDimensions(w, h)
+        .initialize(layout);
+
+    printf("Initialized layout: %#lx aligned to %#x\n", layout.getSize(), layout.getAlignment());
+
+    s_imageMemBlock = dk::MemBlockMaker{s_device, imgui::deko3d::align(layout.getSize(), DK_MEMBLOCK_ALIGNMENT)}
+        .setFlags(DkMemBlockFlags_GpuCached | DkMemBlockFlags_Image)
+        .create();
+
+    printf("Created mem blocks of size %#x & %#x\n", memBlock.getSize(), s_imageMemBlock.getSize());
+
+    dk::Image image;
+    image.initialize(layout, s_imageMemBlock, 0);
+    s_imageDescriptors[BG_IMAGE_ID].initialize(image);
+
+    // copy texture to image
+    dk::ImageView imageView(image);
+    s_cmdBuf[0].copyBufferToImage({memBlock.getGpuAddr() + offset},
+        imageView,
+        {0, 0, 0, w, h, 1});
+    // the descriptor may already be cached when the background is replaced
+    s_cmdBuf[0].barrier(DkBarrier_None, DkInvalidateFlags_Descriptors);
+    s_queue.submitCommands(s_cmdBuf[0].finishList());
+
+    // initialize sampler descriptor
+    s_samplerDescriptors[BG_SAMPLER_ID].initialize(
+        dk::Sampler{}
+            .setFilter(DkFilter_Linear, DkFilter_Linear)
+            .setWrapMode(DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge));
+
+    // wait for commands to complete before releasing memblocks
+    s_queue.waitIdle();
+
+    printf("Done uploading texture\n");
+}
+
+// Textures converted at build time are read in one go into the staging memblock, header included
+bool loadTexture(const std::string &path) {
+    auto *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    fseek(fp, 0, SEEK_END);
+    std::size_t size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (size < sizeof(tx::TextureHeader)) {
+        fclose(fp);
+        return false;
+    }
+
+    auto memBlock = dk::MemBlockMaker{s_device, imgui::deko3d::align(size, DK_MEMBLOCK_ALIGNMENT)}
+        .setFlags(DkMemBlockFlags_CpuUncached | DkMemBlockFlags_GpuCached)
+        .create();
+
+    auto read = fread(memBlock.getCpuAddr(), 1, size, fp);
+    fclose(fp);
+    if (read != size)
+        return false;
+
+    tx::TextureHeader header;
+    std::memcpy(&header, memBlock.getCpuAddr(), sizeof(header));
+    if ((header.magic != tx::texture_magic) || (header.data_size != tx::get_data_size(header.format, header.width, header.height))
+            || (size != sizeof(header) + header.data_size))
+        return false;
+
+    auto format = (header.format == tx::Format::BC1) ? DkImageFormat_RGBA_BC1 : DkImageFormat_RGBA8_Unorm;
+
+    printf("Loaded texture at %s, %ux%u: %#x bytes\n", path.c_str(), header.width, header.height, header.data_size);
+
+    uploadBackground(memBlock, sizeof(header), format, header.width, header.height);
+    return true;
+}
+
 } // namespace
 
 bool init() {
+#ifdef DEBUG
+    ImGui::SetAllocatorFunctions(al::imgui_alloc, al::imgui_free);
+#endif
     ImGui::CreateContext();
     if (!imgui::nx::init())
         return false;
 
+    updateGlyphRanges();
+    imgui::nx::buildFonts(s_glyphRanges.data());
+
     deko3dInit();
     imgui::deko3d::init(s_device,
         s_queue,
@@ -211,6 +316,12 @@ bool init() {
         dkMakeTextureHandle(0, 0),
         FB_NUM);
 
+    // The texture matching the new resolution replaces the background on dock/undock
+    imgui::nx::setOperationModeCallback([] {
+        if (!s_background.empty() && !create_background(s_background))
+            printf("Failed to reload background\n");
+    });
+
     return true;
 }
 
@@ -284,219 +395,25 @@ void exit() {
     deko3dExit();
 }
 
-bool create_background(const std::string &path) {
-    int w, h, nchan;
-    auto *data = stbi_load(path.c_str(), &w, &h, &nchan, 4);
-    if (!data) {
-        printf("Failed to load background image: %s\n", stbi_failure_reason());
-        return false;
-    }
-
-    auto imageSize = w * h * nchan;
-
-    printf("Decoded png at %s, %dx%d with %d channels: %d (%#x) bytes\n", path.c_str(), w, h, nchan, imageSize, imageSize);
-
-    // wait for previous commands to complete
-    s_queue.waitIdle();
-
-    dk::ImageLayout layout;
-    dk::ImageLayoutMaker{s_device}
-        .setFlags(0)
-        .setFormat(DkImageFormat_RGBA8_Unorm)
-        .setDimensions(w, h)
-        .initialize(layout);
-
-    printf("Initialized layout: %#lx aligned to %#x\n", layout.getSize(), layout.getAlignment());
-
-    auto memBlock = dk::MemBlockMaker{s_device, imgui::deko3d::align(imageSize, DK_MEMBLOCK_ALIGNMENT)}
-        .setFlags(DkMemBlockFlags_CpuUncached | DkMemBlockFlags_GpuCached)
-        .create();
-
-    s_imageMemBlock = dk::MemBlockMaker{s_device, imgui::deko3d::align(layout.getSize(), DK_MEMBLOCK_ALIGNMENT)}
-        .setFlags(DkMemBlockFlags_GpuCached | DkMemBlockFlags_Image)
-        .create();
-
-    printf("Created mem blocks of size %#x & %#x\n", memBlock.getSize(), s_imageMemBlock.getSize());
-
-    std::memcpy(memBlock.getCpuAddr(), data, imageSize);
-
-    dk::Image image;
-    image.initialize(layout, s_imageMemBlock, 0);
-    s_imageDescriptors[BG_IMAGE_ID].initialize(image);
-
-    // copy texture to image
-    dk::ImageView imageView(image);
-    s_cmdBuf[0].copyBufferToImage({memBlock.getGpuAddr()},
-        imageView,
-        {0, 0, 0, static_cast<std::uint32_t>(w), static_cast<std::uint32_t>(h), 1});
-    s_queue.submitCommands(s_cmdBuf[0].finishList());
-
-    // initialize sampler descriptor
-    s_samplerDescriptors[BG_SAMPLER_ID].initialize(
-        dk::Sampler{}
-            .setFilter(DkFilter_Linear, DkFilter_Linear)
-            .setWrapMode(DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge));
-
-    // wait for commands to complete before releasing memblocks
-    s_queue.waitIdle();
-
-    stbi_image_free(data);
-
-    printf("Done uploading texture\n");
-
-    return true;
-}
-
-void draw_turnip_tab(const tp::TurnipParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info) {
-    if (!im::BeginTabItem(("turnips"_lang + "###turnips").c_str()))
-        return;
-
-    auto prices  = parser.prices;
-    auto pattern = parser.get_pattern();
-
-    auto days_json = lang::get_json()["days"];
-    std::array day_names = {
-        lang::get_string("sunday",    days_json),
-        lang::get_string("monday",    days_json),
-        lang::get_string("tuesday",   days_json),
-        lang::get_string("wednesday", days_json),
-        lang::get_string("thursday",  days_json),
-        lang::get_string("friday",    days_json),
-        lang::get_string("saturday",  days_json),
-    };
-
-    std::array<float, 14> float_prices;
-    for (std::size_t i = 0; i < prices.week_prices.size(); ++i)
-        float_prices[i] = static_cast<float>(prices.week_prices[i]);
-    auto  minmax  = std::minmax_element(prices.week_prices.begin() + 2, prices.week_prices.end());
-    auto  min = *minmax.first, max = *minmax.second;
-    float average = static_cast<float>(std::accumulate(prices.week_prices.begin() + 2,
-        prices.week_prices.end(), 0)) / (prices.week_prices.size() - 2);
-
-    im::Text("price_pattern"_lang.c_str(), prices.buy_price, pattern.c_str());
-
-    im::BeginTable("##Prices table", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
-    im::TableNextRow();
-    im::TableNextCell(), im::TextUnformatted("am"_lang.c_str());
-    im::TableNextCell(), im::TextUnformatted("pm"_lang.c_str());
-
-    auto get_color = [&](std::uint32_t day, bool is_am) -> std::uint32_t {
-        auto price = prices.week_prices[2 * day + !is_am];
-        if ((cal_info.wday == day) && ((is_am && (cal_time.hour < 12)) || (!is_am && (cal_time.hour >= 12))))
-            return th::text_cur_col;
-        else if (price == max)
-            return th::text_max_col;
-        else if (price == min)
-            return th::text_min_col;
-        return th::text_def_col;
-    };
-
-    auto print_day = [&](std::uint32_t day) -> void {
-        im::TableNextRow(); im::TextUnformatted(day_names[day].c_str());
-        do_with_color(get_color(day, true),  [&] { im::TableNextCell(), im::Text("%d", prices.week_prices[2 * day]); });
-        do_with_color(get_color(day, false), [&] { im::TableNextCell(), im::Text("%d", prices.week_prices[2 * day + 1]); });
-    };
-
-    print_day(0);
-    print_day(1); print_day(2); print_day(3);
-    print_day(4); print_day(5); print_day(6);
-    im::EndTable();
-
-    im::Separator();
-    do_with_color(th::text_max_col, [&] { im::Text("turnips_max"_lang.c_str(), max); }); im::SameLine();
-    do_with_color(th::text_min_col, [&] { im::Text("turnips_min"_lang.c_str(), min); }); im::SameLine();
-    im::Text("turnips_average"_lang.c_str(), average);
-
-    im::Separator();
-    im::TextUnformatted("week_graph"_lang.c_str());
-    im::PlotLines("##Graph", float_prices.data() + 2, float_prices.size() - 2,
-        0, "", FLT_MAX, FLT_MAX, {im::GetWindowWidth() - 30.0f, 125.0f});
-
-    im::EndTabItem();
-}
-
-void draw_visitor_tab(const tp::VisitorParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info) {
-    if (!im::BeginTabItem(("visitors"_lang + "###visitors").c_str()))
+void update_fonts() {
+    if (!updateGlyphRanges())
         return;
 
-    // Visitors leave at 5am, so adjust the weekday
-    auto wday = (cal_time.hour >= 5) ? cal_info.wday : std::clamp(cal_info.wday - 1, 0u, 7u);
-
-    auto days_json = lang::get_json()["days"];
-    std::array day_names = {
-        lang::get_string("sunday",    days_json),
-        lang::get_string("monday",    days_json),
-        lang::get_string("tuesday",   days_json),
-        lang::get_string("wednesday", days_json),
-        lang::get_string("thursday",  days_json),
-        lang::get_string("friday",    days_json),
-        lang::get_string("saturday",  days_json),
-    };
-
-    auto names = parser.get_visitor_names();
-
-    im::Dummy(ImVec2(0.0f, 10.0f));
-    im::BeginTable("##Visitors table", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
-
-    auto get_color = [&](std::uint32_t day) -> std::uint32_t {
-        return (wday == day) ? th::text_cur_col : th::text_def_col;
-    };
-
-    auto print_day = [&](std::uint32_t day) -> void {
-        im::TableNextCell(); im::TextUnformatted(day_names[day].c_str());
-        do_with_color(get_color(day), [&] {
-            im::TableNextCell(), im::Text("%s", names[day].c_str());
-            if (day == parser.get_celeste_day())
-                im::SameLine(), im::TextUnformatted(lang::get_string("celeste", lang::get_json()["npcs"]).c_str());
-            if (day == parser.get_wisp_day())
-                im::SameLine(), im::TextUnformatted(lang::get_string("wisp",    lang::get_json()["npcs"]).c_str());
-        });
-    };
-
-    print_day(1); print_day(2); print_day(3);
-    print_day(4); print_day(5); print_day(6);
-    print_day(0);
-    im::EndTable();
-
-    im::EndTabItem();
+    imgui::nx::buildFonts(s_glyphRanges.data());
+    imgui::deko3d::updateFontTexture(s_device, s_queue, s_cmdBuf[0], s_imageDescriptors[0]);
 }
 
-void draw_weather_tab(const tp::WeatherSeedParser &parser) {
-    if (!im::BeginTabItem(("weather"_lang + "###weather").c_str()))
-        return;
-
-    auto seed = parser.calculate_weather_seed();
-
-    im::Dummy(ImVec2(0.0f, 10.0f));
-    im::Text("hemisphere"_lang.c_str(), parser.get_hemisphere_name().c_str());
-    im::Text("weather_seed"_lang.c_str(), seed, seed);
-
-    im::Separator();
-    im::TextUnformatted("weather_url_tip"_lang.c_str());
-
-    im::EndTabItem();
-}
-
-void draw_language_tab() {
-    if (!im::BeginTabItem(("language"_lang + "###lang").c_str()))
-        return;
-
-    auto cur_lang = lang::get_current_language(), prev_lang = cur_lang;
-    im::RadioButton("English",    reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::English));
-    im::RadioButton("中文",        reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Chinese));
-    im::RadioButton("Français",   reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::French));
-    im::RadioButton("Nederlands", reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Dutch));
-    im::RadioButton("Italiano",   reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Italian));
-    im::RadioButton("Deutsch",    reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::German));
-    im::RadioButton("Español",    reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Spanish));
-
-    if (cur_lang != prev_lang)
-        lang::set_language(cur_lang);
-
-    im::Separator();
-    im::TextUnformatted("If you'd like to see your language here, make an issue on\nhttps://github.com/averne/Turnips");
+bool create_background(const std::string &name) {
+    // Use the texture converted for the current resolution
+    auto height = (appletGetOperationMode() == AppletOperationMode_Handheld) ? 720 : 1080;
+    auto path   = "romfs:/textures/" + name + "_" + std::to_string(height) + ".tex";
+    if (!loadTexture(path)) {
+        printf("Failed to load background texture %s\n", path.c_str());
+        return false;
+    }
 
-    im::EndTabItem();
+    s_background = name;
+    return true;
 }
 
 } // namespace gui
@@ -21,9 +21,12 @@
 #include <array>
 #include <string>
 #include <imgui.h>
-#include <switch.h>
 
-#include "parser.hpp"
+#ifdef __SWITCH__
+#   include <switch.h>
+#endif
+
+#include "view.hpp"
 
 namespace im {
     using namespace ImGui;
@@ -36,12 +39,25 @@ bool loop();
 void render();
 void exit();
 
-bool create_background(const std::string &path);
+// Rebuilds the font atlas if the current language needs other glyphs, to be called between frames
+void update_fonts();
+
+// Loads the background texture converted for the current resolution by the build, named after the image in res/
+bool create_background(const std::string &name);
+
+// What the user asked for during the frame
+struct Actions {
+    bool language_changed;
+    bool check_save;
+};
+
+// Builds the main window, to be called between loop and render
+Actions draw_main_window(const vm::Views &views);
 
-void draw_turnip_tab(const tp::TurnipParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info);
-void draw_visitor_tab(const tp::VisitorParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info);
-void draw_weather_tab(const tp::WeatherSeedParser &parser);
-void draw_language_tab();
+void draw_turnip_tab(const vm::TurnipView &view);
+void draw_visitor_tab(const vm::VisitorView &view);
+void draw_weather_tab(const vm::WeatherView &view);
+bool draw_language_tab(const vm::LanguageView &view);
 
 template <typename F>
 void do_with_color(std::uint32_t col, F f) {
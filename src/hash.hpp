@@ -0,0 +1,401 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace tp {
+enum class Version: std::size_t;
+} // namespace tp
+
+namespace hs {
+
+// Murmur3-32 of [hash_offset + 4, hash_offset + 4 + size), stored little-endian at hash_offset
+struct Region {
+    std::uint32_t hash_offset, size;
+
+    constexpr inline std::size_t begin() const {
+        return this->hash_offset + sizeof(std::uint32_t);
+    }
+
+    constexpr inline std::size_t end() const {
+        return this->begin() + this->size;
+    }
+
+    constexpr inline bool operator ==(const Region &other) const {
+        return (this->hash_offset == other.hash_offset) && (this->size == other.size);
+    }
+};
+
+struct Layout {
+    constexpr static std::size_t max_regions = 0x20;
+
+    std::size_t                        file_size = 0;
+    std::size_t                        count     = 0;
+    std::array<Region, max_regions>    regions   = {};
+
+    constexpr inline bool is_known() const {
+        return this->count != 0;
+    }
+
+    constexpr inline const Region *begin() const {
+        return this->regions.data();
+    }
+
+    constexpr inline const Region *end() const {
+        return this->regions.data() + this->count;
+    }
+};
+
+// From NHSE, main.dat is made of the island, hashed in two regions, the eight players, each laid out like personal.dat
+// with two regions, and a last region. The island and player blocks start with a 0x108 bytes header,
+// and the regions of a block follow each other. The layout of a revision is fully given by the sizes of its regions
+struct MainShape {
+    std::array<std::uint32_t, 2> island;
+    std::array<std::uint32_t, 2> player;
+    std::uint32_t                tail;
+
+    constexpr inline bool operator ==(const MainShape &other) const {
+        return (this->island[0] == other.island[0]) && (this->island[1] == other.island[1]) &&
+            (this->player[0] == other.player[0]) && (this->player[1] == other.player[1]) && (this->tail == other.tail);
+    }
+
+    constexpr inline bool operator !=(const MainShape &other) const {
+        return !(*this == other);
+    }
+};
+
+constexpr std::size_t num_players = 8, block_header_size = 0x108;
+
+constexpr Layout make_main_layout(const MainShape &shape) {
+    Layout layout;
+    std::size_t offset = block_header_size;
+    auto add = [&](std::uint32_t size) {
+        layout.regions[layout.count++] = { static_cast<std::uint32_t>(offset), size };
+        offset += sizeof(std::uint32_t) + size;
+    };
+
+    add(shape.island[0]), add(shape.island[1]);
+    for (std::size_t i = 0; i < num_players; ++i) {
+        offset += block_header_size;
+        add(shape.player[0]), add(shape.player[1]);
+    }
+    add(shape.tail);
+
+    layout.file_size = offset;
+    return layout;
+}
+
+namespace impl {
+
+// From NHSE
+constexpr std::array main_regions_v100 = {
+    Region{ 0x000108, 0x1d6d4c }, Region{ 0x1d6e58, 0x323384 },
+    Region{ 0x4fa2e8, 0x035ac4 }, Region{ 0x52fdb0, 0x03607c },
+    Region{ 0x565f38, 0x035ac4 }, Region{ 0x59ba00, 0x03607c },
+    Region{ 0x5d1b88, 0x035ac4 }, Region{ 0x607650, 0x03607c },
+    Region{ 0x63d7d8, 0x035ac4 }, Region{ 0x6732a0, 0x03607c },
+    Region{ 0x6a9428, 0x035ac4 }, Region{ 0x6deef0, 0x03607c },
+    Region{ 0x715078, 0x035ac4 }, Region{ 0x74ab40, 0x03607c },
+    Region{ 0x780cc8, 0x035ac4 }, Region{ 0x7b6790, 0x03607c },
+    Region{ 0x7ec918, 0x035ac4 }, Region{ 0x8223e0, 0x03607c },
+    Region{ 0x858460, 0x2684d4 },
+};
+
+constexpr MainShape main_shape_v100 = { { 0x1d6d4c, 0x323384 }, { 0x035ac4, 0x03607c }, 0x2684d4 };
+
+constexpr bool matches_table(const Layout &layout, const decltype(main_regions_v100) &table) {
+    if (layout.count != table.size())
+        return false;
+    for (std::size_t i = 0; i < table.size(); ++i)
+        if (!(layout.regions[i] == table[i]))
+            return false;
+    return true;
+}
+
+static_assert(matches_table(make_main_layout(main_shape_v100), main_regions_v100));
+static_assert(make_main_layout(main_shape_v100).file_size == 0xac0938);
+
+// NHSE's tables of later revisions are not carried here. Their shapes are found in the save itself by find_main_shape,
+// or taken from an earlier intact save of the same revision, see check_main
+constexpr std::array main_shapes = {
+    main_shape_v100,                                                // 1.0.0
+    MainShape{}, MainShape{}, MainShape{}, MainShape{}, MainShape{}, // 1.1.x
+    MainShape{}, MainShape{},                                       // 1.2.x
+    MainShape{}, MainShape{},                                       // 1.3.x
+    MainShape{}, MainShape{}, MainShape{},                          // 1.4.x
+    MainShape{}, MainShape{},                                       // 1.5.x
+    MainShape{},                                                    // 1.6.0
+};
+
+constexpr std::uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+
+constexpr inline std::uint32_t rotl(std::uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline std::uint32_t load_u32(const std::uint8_t *data) {
+    std::uint32_t v;
+    std::memcpy(&v, data, sizeof(v));
+    return v;
+}
+
+// Tail bytes and finalization mix
+inline std::uint32_t murmur3_finish(std::uint32_t h, const std::uint8_t *tail, std::size_t size) {
+    std::uint32_t k = 0;
+    switch (size & 3) {
+        case 3: k ^= tail[2] << 16; [[fallthrough]];
+        case 2: k ^= tail[1] << 8;  [[fallthrough]];
+        case 1: k ^= tail[0];
+            h ^= rotl(k * c1, 15) * c2;
+    }
+
+    h ^= static_cast<std::uint32_t>(size);
+    h ^= h >> 16, h *= 0x85ebca6b;
+    h ^= h >> 13, h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+} // namespace impl
+
+// Shape from the table of the revision, empty if there is none
+constexpr inline MainShape get_main_shape(tp::Version version) {
+    auto idx = static_cast<std::size_t>(version);
+    return (idx < impl::main_shapes.size()) ? impl::main_shapes[idx] : MainShape{};
+}
+
+// Layout from the table of the revision, unknown if there is none
+constexpr inline Layout get_main_layout(tp::Version version) {
+    auto shape = get_main_shape(version);
+    return shape.tail ? make_main_layout(shape) : Layout{};
+}
+
+inline std::uint32_t murmur3(const std::uint8_t *data, std::size_t size, std::uint32_t seed = 0) {
+    using namespace impl;
+
+    auto h = seed;
+    for (std::size_t i = 0; i < size / 4; ++i) {
+        h ^= rotl(load_u32(data + 4 * i) * c1, 15) * c2;
+        h  = rotl(h, 13) * 5 + 0xe6546b64;
+    }
+    return murmur3_finish(h, data + (size & ~3ul), size);
+}
+
+// Hashes 4 buffers of the same size at once, one per vector lane
+inline std::array<std::uint32_t, 4> murmur3_x4(const std::array<const std::uint8_t *, 4> &data, std::size_t size, std::uint32_t seed = 0) {
+    using namespace impl;
+    using u32x4 = std::uint32_t __attribute__((vector_size(16)));
+
+    u32x4 h = { seed, seed, seed, seed };
+    for (std::size_t off = 0; off < (size & ~3ul); off += 4) {
+        u32x4 k = { load_u32(data[0] + off), load_u32(data[1] + off), load_u32(data[2] + off), load_u32(data[3] + off) };
+        k *= c1;
+        k  = (k << 15) | (k >> 17);
+        k *= c2;
+        h ^= k;
+        h  = (h << 13) | (h >> 19);
+        h  = h * 5 + 0xe6546b64;
+    }
+
+    std::array<std::uint32_t, 4> res;
+    for (std::size_t i = 0; i < res.size(); ++i)
+        res[i] = murmur3_finish(h[i], data[i] + (size & ~3ul), size);
+    return res;
+}
+
+// Checks every hash region of a decrypted main.dat, and returns the ones not matching their stored hash.
+// Regions of the same size are hashed together in vector lanes, and the resulting batches are spread over the threads
+inline std::vector<Region> verify(const Layout &layout, const std::uint8_t *data, std::size_t size,
+        std::size_t num_threads = par::core_count()) {
+    if (!layout.is_known() || (size < layout.file_size))
+        return {};
+
+    std::vector<Region> regions(layout.begin(), layout.end());
+    std::stable_sort(regions.begin(), regions.end(), [](const Region &lhs, const Region &rhs) { return lhs.size > rhs.size; });
+
+    // Largest batches first, so no thread is left with a big one at the end
+    std::vector<std::pair<std::size_t, std::size_t>> batches;
+    for (std::size_t i = 0, j; i < regions.size(); i = j) {
+        for (j = i + 1; (j < regions.size()) && (j - i < 4) && (regions[j].size == regions[i].size); ++j);
+        batches.emplace_back(i, j);
+    }
+
+    std::mutex mtx;
+    std::vector<Region> corrupt;
+
+    auto check = [&](const Region &region, std::uint32_t hash) {
+        if (impl::load_u32(data + region.hash_offset) != hash) {
+            std::lock_guard lk(mtx);
+            corrupt.push_back(region);
+        }
+    };
+
+    par::for_each(batches.size(), num_threads, [&](std::size_t b, std::size_t) {
+        auto [first, last] = batches[b];
+        if (last - first == 4) {
+            auto hashes = murmur3_x4({ data + regions[first].begin(), data + regions[first + 1].begin(),
+                data + regions[first + 2].begin(), data + regions[first + 3].begin() }, regions[first].size);
+            for (std::size_t i = 0; i < hashes.size(); ++i)
+                check(regions[first + i], hashes[i]);
+        } else {
+            for (auto i = first; i < last; ++i)
+                check(regions[i], murmur3(data + regions[i].begin(), regions[i].size));
+        }
+    });
+
+    std::sort(corrupt.begin(), corrupt.end(), [](const Region &lhs, const Region &rhs) { return lhs.hash_offset < rhs.hash_offset; });
+    return corrupt;
+}
+
+namespace impl {
+
+// Hashes the bytes following a stored hash 4 at a time, stopping at every size where the hash matches.
+// Only sizes multiple of 4 are tried, like every region of 1.0.0
+class RegionScanner {
+    private:
+        const std::uint8_t *data;
+        std::size_t         start, end, pos;
+        std::uint32_t       expected, h = 0;
+
+    public:
+        RegionScanner(const std::uint8_t *data, std::size_t size, std::size_t hash_offset):
+            data(data), start(hash_offset + sizeof(std::uint32_t)), end(size), pos(start),
+            expected((start <= size) ? load_u32(data + hash_offset) : 0) { }
+
+        bool next(std::uint32_t &size) {
+            while (this->pos + sizeof(std::uint32_t) <= this->end) {
+                this->h ^= rotl(load_u32(this->data + this->pos) * c1, 15) * c2;
+                this->h  = rotl(this->h, 13) * 5 + 0xe6546b64;
+                this->pos += sizeof(std::uint32_t);
+
+                auto cur = this->pos - this->start;
+                if (murmur3_finish(this->h, nullptr, cur) == this->expected) {
+                    size = cur;
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+} // namespace impl
+
+// Finds the shape of a revision without a table, from the sizes at which the island regions and those of the first
+// player match their stored hash. A candidate is accepted once a region it places further in the file matches as well,
+// so a chance match is skipped while the later regions may be corrupt.
+// Returns an empty shape if one of the scanned regions is corrupt
+inline MainShape find_main_shape(const std::uint8_t *data, std::size_t size) {
+    constexpr std::size_t num_scanned = 4;
+
+    MainShape shape = {};
+
+    auto island_1 = block_header_size;
+    for (auto s0 = impl::RegionScanner(data, size, island_1); s0.next(shape.island[0]);) {
+        auto island_2 = island_1 + sizeof(std::uint32_t) + shape.island[0];
+        for (auto s1 = impl::RegionScanner(data, size, island_2); s1.next(shape.island[1]);) {
+            auto player_1 = island_2 + sizeof(std::uint32_t) + shape.island[1] + block_header_size;
+            for (auto s2 = impl::RegionScanner(data, size, player_1); s2.next(shape.player[0]);) {
+                auto player_2 = player_1 + sizeof(std::uint32_t) + shape.player[0];
+                for (auto s3 = impl::RegionScanner(data, size, player_2); s3.next(shape.player[1]);) {
+                    // The last region takes up the rest of the file
+                    auto players_end = player_1 - block_header_size
+                        + num_players * (block_header_size + 2 * sizeof(std::uint32_t) + shape.player[0] + shape.player[1]);
+                    if (players_end + sizeof(std::uint32_t) >= size)
+                        break;
+                    shape.tail = size - players_end - sizeof(std::uint32_t);
+
+                    if (auto layout = make_main_layout(shape); verify(layout, data, size).size() < layout.count - num_scanned)
+                        return shape;
+                }
+            }
+        }
+    }
+
+    return {};
+}
+
+inline Layout find_main_layout(const std::uint8_t *data, std::size_t size) {
+    auto shape = find_main_shape(data, size);
+    return shape.tail ? make_main_layout(shape) : Layout{};
+}
+
+struct Report {
+    bool                known_layout = false; // Whether the regions could be located at all
+    std::size_t         num_regions  = 0;
+    std::vector<Region> corrupt;
+    MainShape           shape        = {};    // Of the layout the save was checked against
+};
+
+// Verifies a decrypted main.dat against the table of its revision. Without one, the shape of an earlier intact save
+// of the revision is used if the caller kept it, and the layout is looked for in the save otherwise.
+// Corruption in the island or first player regions then leaves the layout unknown
+inline Report check_main(tp::Version version, const std::uint8_t *data, std::size_t size, const MainShape &learned = {}) {
+    auto shape = get_main_shape(version);
+    if (!shape.tail)
+        shape = learned;
+    if (!shape.tail || (make_main_layout(shape).file_size != size))
+        shape = find_main_shape(data, size);
+    if (!shape.tail)
+        return {};
+
+    auto layout = make_main_layout(shape);
+    if (size != layout.file_size)
+        return {};
+    return { true, layout.count, verify(layout, data, size), shape };
+}
+
+// Recomputes the hashes of the regions whose contents were modified in the image, and returns how many were updated.
+// Only done when the image matches the layout, as writing hashes at the wrong place would corrupt the save
+template <typename Image>
+std::size_t update_dirty(const Layout &layout, Image &image) {
+    if (!layout.is_known() || (image.size() != layout.file_size)) {
+        printf("Unknown save layout, not updating hashes\n");
+        return 0;
+    }
+
+    auto dirty = image.dirty_ranges();
+
+    std::size_t count = 0;
+    std::vector<std::uint8_t> buf;
+    for (auto &region: layout) {
+        auto overlaps = std::any_of(dirty.begin(), dirty.end(), [&region](const auto &range) {
+            return (range.first < region.end()) && (range.second > region.begin());
+        });
+        if (!overlaps)
+            continue;
+
+        buf.resize(region.size);
+        image.read(buf.data(), buf.size(), region.begin());
+        image.write(murmur3(buf.data(), buf.size()), region.hash_offset);
+        ++count;
+    }
+
+    return count;
+}
+
+} // namespace hs
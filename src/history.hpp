@@ -0,0 +1,345 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "fs.hpp"
+#include "hash.hpp"
+#include "parser.hpp"
+
+namespace hist {
+
+// What is kept of each parse of the save
+struct Snapshot {
+    std::uint64_t                timestamp    = 0; // DateParser::to_posix
+    tp::TurnipPrices             prices       = {};
+    std::array<std::uint32_t, 7> npcs         = {};
+    std::uint32_t                weather_seed = 0;
+};
+
+namespace impl {
+
+// Every field but the timestamp, in column order
+constexpr std::size_t num_columns = 1 + 14 + 2 + 7 + 1;
+
+inline std::array<std::uint32_t, num_columns> to_columns(const Snapshot &s) {
+    std::array<std::uint32_t, num_columns> res;
+    auto *it = res.begin();
+    *it++ = s.prices.buy_price;
+    it = std::copy(s.prices.week_prices.begin(), s.prices.week_prices.end(), it);
+    *it++ = s.prices.pattern_type, *it++ = s.prices.unk;
+    it = std::copy(s.npcs.begin(), s.npcs.end(), it);
+    *it++ = s.weather_seed;
+    return res;
+}
+
+inline Snapshot from_columns(std::uint64_t timestamp, const std::array<std::uint32_t, num_columns> &cols) {
+    Snapshot s;
+    s.timestamp = timestamp;
+    auto *it = cols.begin();
+    s.prices.buy_price = *it++;
+    std::copy_n(it, s.prices.week_prices.size(), s.prices.week_prices.begin()), it += s.prices.week_prices.size();
+    s.prices.pattern_type = *it++, s.prices.unk = *it++;
+    std::copy_n(it, s.npcs.size(), s.npcs.begin()), it += s.npcs.size();
+    s.weather_seed = *it++;
+    return s;
+}
+
+constexpr inline std::uint64_t zigzag(std::int64_t v) {
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+constexpr inline std::int64_t unzigzag(std::uint64_t v) {
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+inline void put_varint(std::vector<std::uint8_t> &out, std::uint64_t v) {
+    for (; v >= 0x80; v >>= 7)
+        out.push_back(static_cast<std::uint8_t>(v) | 0x80);
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+inline bool get_varint(const std::uint8_t *&p, const std::uint8_t *end, std::uint64_t &v) {
+    v = 0;
+    for (int shift = 0; (p < end) && (shift < 64); shift += 7) {
+        auto byte = *p++;
+        v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+} // namespace impl
+
+// Append-only store of snapshots on the SD card, ordered by timestamp.
+// Snapshots are grouped in blocks, each column of a block stored as a run of varint-encoded deltas.
+// Every append adds a block after the last one, so recorded snapshots are never rewritten in place. Once the blocks
+// of single appends pile up, the history is compacted into full blocks in a new file, which then replaces the old one.
+// Block headers are loaded on open and form the index, so lookups only decode the blocks they need
+class History {
+    public:
+        constexpr static std::uint32_t block_magic    = 0x42485354; // "TSHB"
+        constexpr static std::size_t   block_capacity = 64;
+
+        // Number of blocks over the minimum needed for the snapshots, above which the history is compacted
+        constexpr static std::size_t   compact_slack  = 64;
+
+        struct BlockHeader {
+            std::uint32_t magic, count;
+            std::uint64_t first, last;
+            std::uint32_t payload_size, hash;
+        };
+
+        struct IndexEntry {
+            std::uint64_t first, last;
+            std::size_t   offset;
+            std::uint32_t count;
+        };
+
+    private:
+        fs::File                file;
+        std::vector<IndexEntry> index;
+        std::size_t             end_offset = 0;
+
+    public:
+        // Creates the file if needed, and finishes or drops an interrupted compaction.
+        // A block cut short by an interrupted write is dropped along with everything after it
+        Result open(fs::Filesystem &fs, const std::string &path) {
+            // The old file is only deleted once the compacted one is complete
+            auto tmp_path = path + ".tmp";
+            if (fs.is_file(tmp_path)) {
+                if (fs.is_file(path))
+                    fs.delete_file(tmp_path);
+                else if (auto rc = fs.move_file(tmp_path, path); R_FAILED(rc))
+                    return rc;
+            }
+
+            if (!fs.is_file(path)) {
+                fs.create_directory(path.substr(0, path.rfind('/')));
+                if (auto rc = fs.create_file(path); R_FAILED(rc))
+                    return rc;
+            }
+
+            if (auto rc = this->load(fs, path); R_FAILED(rc))
+                return rc;
+
+            if (this->index.size() > (this->size() + block_capacity - 1) / block_capacity + compact_slack) {
+                if (auto rc = this->compact(fs, path, tmp_path); R_FAILED(rc))
+                    printf("Failed to compact history: %#x\n", rc);
+            }
+
+            return 0;
+        }
+
+        inline std::size_t size() const {
+            std::size_t res = 0;
+            for (auto &entry: this->index)
+                res += entry.count;
+            return res;
+        }
+
+        inline std::size_t num_blocks() const {
+            return this->index.size();
+        }
+
+        // Snapshots must come in order. One with the same timestamp as the last is considered already recorded,
+        // and an older one, from a save restored from a backup, is skipped as the history already covers that time
+        Result append(const Snapshot &snapshot) {
+            if (!this->index.empty() && (snapshot.timestamp <= this->index.back().last))
+                return 0;
+
+            auto block = encode_block(&snapshot, 1);
+            if (auto rc = this->file.write(block.data(), block.size(), this->end_offset); R_FAILED(rc))
+                return rc;
+            this->file.flush();
+
+            this->index.push_back({ snapshot.timestamp, snapshot.timestamp, this->end_offset, 1 });
+            this->end_offset += block.size();
+            return 0;
+        }
+
+        // Snapshots with a timestamp in [from, to)
+        std::vector<Snapshot> query(std::uint64_t from, std::uint64_t to) {
+            std::vector<Snapshot> res, block;
+
+            auto it = std::lower_bound(this->index.begin(), this->index.end(), from,
+                [](const IndexEntry &entry, std::uint64_t ts) { return entry.last < ts; });
+            for (; (it != this->index.end()) && (it->first < to); ++it) {
+                BlockHeader hdr;
+                if (!this->read_block(it->offset, hdr, block))
+                    break;
+
+                for (auto &s: block)
+                    if ((s.timestamp >= from) && (s.timestamp < to))
+                        res.push_back(s);
+            }
+
+            return res;
+        }
+
+        // Last snapshot taken at or before a timestamp
+        bool find(std::uint64_t timestamp, Snapshot &out) {
+            auto it = std::upper_bound(this->index.begin(), this->index.end(), timestamp,
+                [](std::uint64_t ts, const IndexEntry &entry) { return ts < entry.first; });
+            if (it == this->index.begin())
+                return false;
+            --it;
+
+            auto res = this->query(it->first, timestamp + 1);
+            if (res.empty())
+                return false;
+            out = res.back();
+            return true;
+        }
+
+    private:
+        Result load(fs::Filesystem &fs, const std::string &path) {
+            if (auto rc = fs.open_file(this->file, path, FsOpenMode_Read | FsOpenMode_Write | FsOpenMode_Append); R_FAILED(rc))
+                return rc;
+
+            this->index.clear(), this->end_offset = 0;
+
+            auto size = this->file.size();
+            std::vector<Snapshot> snapshots;
+            while (this->end_offset < size) {
+                BlockHeader hdr;
+                if (!this->read_block(this->end_offset, hdr, snapshots)) {
+                    printf("Dropping corrupt history from %#lx\n", this->end_offset);
+                    this->file.size(this->end_offset);
+                    break;
+                }
+
+                this->index.push_back({ hdr.first, hdr.last, this->end_offset, hdr.count });
+                this->end_offset += sizeof(hdr) + hdr.payload_size;
+            }
+
+            return 0;
+        }
+
+        // Writes the snapshots in full blocks to a new file, then swaps it with the current one
+        Result compact(fs::Filesystem &fs, const std::string &path, const std::string &tmp_path) {
+            auto snapshots = this->query(0, UINT64_MAX);
+            if (snapshots.size() != this->size())
+                return 1;
+
+            {
+                fs::File tmp;
+                auto rc = fs.create_file(tmp_path);
+                if (R_SUCCEEDED(rc))
+                    rc = fs.open_file(tmp, tmp_path, FsOpenMode_Write | FsOpenMode_Append);
+
+                for (std::size_t i = 0, offset = 0; R_SUCCEEDED(rc) && (i < snapshots.size()); i += block_capacity) {
+                    auto block = encode_block(snapshots.data() + i, std::min(block_capacity, snapshots.size() - i));
+                    rc = tmp.write(block.data(), block.size(), offset);
+                    offset += block.size();
+                }
+
+                tmp.flush();
+                if (R_FAILED(rc)) {
+                    tmp.close();
+                    fs.delete_file(tmp_path);
+                    return rc;
+                }
+            }
+
+            this->file.close();
+            if (auto rc = fs.delete_file(path); R_FAILED(rc)) {
+                fs.delete_file(tmp_path);
+                this->load(fs, path);
+                return rc;
+            }
+
+            // Picked up by the next open if this fails
+            if (auto rc = fs.move_file(tmp_path, path); R_FAILED(rc))
+                return rc;
+            return this->load(fs, path);
+        }
+
+        static std::vector<std::uint8_t> encode_block(const Snapshot *snapshots, std::size_t count) {
+            std::vector<std::uint8_t> res(sizeof(BlockHeader));
+
+            std::uint64_t prev_ts = snapshots[0].timestamp;
+            for (std::size_t i = 0; i < count; ++i)
+                impl::put_varint(res, snapshots[i].timestamp - prev_ts), prev_ts = snapshots[i].timestamp;
+
+            std::vector<std::array<std::uint32_t, impl::num_columns>> rows;
+            rows.reserve(count);
+            for (std::size_t i = 0; i < count; ++i)
+                rows.push_back(impl::to_columns(snapshots[i]));
+
+            for (std::size_t col = 0; col < impl::num_columns; ++col) {
+                std::uint32_t prev = 0;
+                for (auto &row: rows) {
+                    impl::put_varint(res, impl::zigzag(static_cast<std::int64_t>(row[col]) - prev));
+                    prev = row[col];
+                }
+            }
+
+            auto payload_size = static_cast<std::uint32_t>(res.size() - sizeof(BlockHeader));
+            auto hdr = BlockHeader{ block_magic, static_cast<std::uint32_t>(count),
+                snapshots[0].timestamp, snapshots[count - 1].timestamp,
+                payload_size, hs::murmur3(res.data() + sizeof(BlockHeader), payload_size) };
+            std::memcpy(res.data(), &hdr, sizeof(hdr));
+            return res;
+        }
+
+        bool read_block(std::size_t offset, BlockHeader &hdr, std::vector<Snapshot> &out) {
+            if ((this->file.read(&hdr, sizeof(hdr), offset) != sizeof(hdr)) || (hdr.magic != block_magic)
+                    || !hdr.count || (hdr.count > block_capacity))
+                return false;
+
+            std::vector<std::uint8_t> payload(hdr.payload_size);
+            if ((this->file.read(payload.data(), payload.size(), offset + sizeof(hdr)) != payload.size())
+                    || (hs::murmur3(payload.data(), payload.size()) != hdr.hash))
+                return false;
+
+            const std::uint8_t *p = payload.data(), *end = p + payload.size();
+            std::vector<std::uint64_t> timestamps(hdr.count);
+            std::uint64_t v, ts = hdr.first;
+            for (auto &t: timestamps) {
+                if (!impl::get_varint(p, end, v))
+                    return false;
+                t = ts += v;
+            }
+
+            std::vector<std::array<std::uint32_t, impl::num_columns>> rows(hdr.count);
+            for (std::size_t col = 0; col < impl::num_columns; ++col) {
+                std::uint32_t prev = 0;
+                for (auto &row: rows) {
+                    if (!impl::get_varint(p, end, v))
+                        return false;
+                    row[col] = prev = static_cast<std::uint32_t>(prev + impl::unzigzag(v));
+                }
+            }
+
+            out.clear();
+            for (std::size_t i = 0; i < hdr.count; ++i)
+                out.push_back(impl::from_columns(timestamps[i], rows[i]));
+            return true;
+        }
+};
+
+} // namespace hist
@@ -281,13 +281,33 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 		        .create ());
 	}
 
+	// initialize sampler descriptor
+	samplerDescriptor_.initialize (
+	    dk::Sampler{}
+	        .setFilter (DkFilter_Linear, DkFilter_Linear)
+	        .setWrapMode (DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge));
+
 	// get texture atlas
 	io.Fonts->SetTexID (makeTextureID (fontTextureHandle_));
 	s_fontTextureHandle = fontTextureHandle_;
+	updateFontTexture (device_, queue_, cmdBuf_, imageDescriptor_);
+}
+
+void imgui::deko3d::updateFontTexture (dk::UniqueDevice &device_,
+    dk::UniqueQueue &queue_,
+    dk::UniqueCmdBuf &cmdBuf_,
+    dk::ImageDescriptor &imageDescriptor_)
+{
+	auto &io = ImGui::GetIO ();
+
 	unsigned char *pixels;
 	int width;
 	int height;
 	io.Fonts->GetTexDataAsAlpha8 (&pixels, &width, &height);
+	io.Fonts->SetTexID (makeTextureID (s_fontTextureHandle));
+
+	// the previous texture may still be sampled
+	queue_.waitIdle ();
 
 	// create memblock for transfer
 	dk::UniqueMemBlock memBlock =
@@ -296,12 +316,6 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 	        .create ();
 	std::memcpy (memBlock.getCpuAddr (), pixels, width * height);
 
-	// initialize sampler descriptor
-	samplerDescriptor_.initialize (
-	    dk::Sampler{}
-	        .setFilter (DkFilter_Linear, DkFilter_Linear)
-	        .setWrapMode (DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge));
-
 	// initialize texture atlas image layout
 	dk::ImageLayout layout;
 	dk::ImageLayoutMaker{device_}
@@ -329,11 +343,16 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 	cmdBuf_.copyBufferToImage ({memBlock.getGpuAddr ()}, imageView,
 		{0, 0, 0, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), 1});
 
+	// the descriptor was rewritten in place, drop cached copies before the next draw samples it
+	cmdBuf_.barrier (DkBarrier_None, DkInvalidateFlags_Descriptors);
+
 	// submit commands to transfer font texture
 	queue_.submitCommands (cmdBuf_.finishList ());
 
 	// wait for commands to complete before releasing memblock
 	queue_.waitIdle ();
+
+	std::printf ("Uploaded font texture: %dx%d, %#lx bytes\n", width, height, fontSize);
 }
 
 void imgui::deko3d::exit ()
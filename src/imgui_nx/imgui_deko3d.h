@@ -52,6 +52,16 @@ void init (dk::UniqueDevice &device_,
     DkResHandle fontTextureHandle_,
     unsigned imageCount_);
 
+/// \brief Upload the font atlas after it was rebuilt, waits for the queue to be idle
+/// \param device_ deko3d device (used to allocate the font texture)
+/// \param queue_ deko3d queue (used to run command lists)
+/// \param cmdBuf_ Command buffer (used to build command lists)
+/// \param[out] imageDescriptor_ Image descriptor for font texture
+void updateFontTexture (dk::UniqueDevice &device_,
+    dk::UniqueQueue &queue_,
+    dk::UniqueCmdBuf &cmdBuf_,
+    dk::ImageDescriptor &imageDescriptor_);
+
 /// \brief Deinitialize deko3d
 void exit ();
 
@@ -36,6 +36,8 @@
 #include <utility>
 #include <switch.h>
 
+#include "../fonts.hpp"
+
 using namespace std::chrono_literals;
 
 namespace {
@@ -49,6 +51,8 @@ ImVec2 s_mousePos = ImVec2(0.0f, 0.0f);
 
 AppletHookCookie s_appletHookCookie;
 
+std::function<void()> s_operationModeCallback;
+
 void handleAppletHook(AppletHookType type, void *param) {
     if (type != AppletHookType_OnOperationMode)
         return;
@@ -71,6 +75,9 @@ void handleAppletHook(AppletHookType type, void *param) {
             ImGui::GetIO().FontGlobalScale = 1.6f;
             break;
     }
+
+    if (s_operationModeCallback)
+        s_operationModeCallback();
 }
 
 void updateTouch(ImGuiIO &io_) {
@@ -118,28 +125,6 @@ void updateKeys(ImGuiIO &io_) {
 bool imgui::nx::init() {
     auto &io = ImGui::GetIO();
 
-    // Load nintendo font
-    PlFontData standard, extended, chinese, korean;
-    static ImWchar extended_range[] = {0xe000, 0xe152};
-    if (R_SUCCEEDED(plGetSharedFontByType(&standard,     PlSharedFontType_Standard)) &&
-            R_SUCCEEDED(plGetSharedFontByType(&extended, PlSharedFontType_NintendoExt)) &&
-            R_SUCCEEDED(plGetSharedFontByType(&chinese,  PlSharedFontType_ChineseSimplified))) {
-        std::uint8_t *px;
-        int w, h, bpp;
-        ImFontConfig font_cfg;
-
-        font_cfg.FontDataOwnedByAtlas = false;
-        io.Fonts->AddFontFromMemoryTTF(standard.address, standard.size, 20.0f, &font_cfg, io.Fonts->GetGlyphRangesDefault());
-        font_cfg.MergeMode            = true;
-        io.Fonts->AddFontFromMemoryTTF(extended.address, extended.size, 20.0f, &font_cfg, extended_range);
-        io.Fonts->AddFontFromMemoryTTF(chinese.address,  chinese.size,  20.0f, &font_cfg, io.Fonts->GetGlyphRangesChineseFull());
-
-        // build font atlas
-        io.Fonts->GetTexDataAsAlpha8(&px, &w, &h, &bpp);
-        io.Fonts->Flags |= ImFontAtlasFlags_NoPowerOfTwoHeight;
-        io.Fonts->Build();
-    }
-
     auto &style = ImGui::GetStyle();
     style.WindowRounding = 0.0f;
 
@@ -172,6 +157,38 @@ bool imgui::nx::init() {
     return true;
 }
 
+bool imgui::nx::buildFonts(const ImWchar *ranges) {
+    auto &io = ImGui::GetIO();
+
+    // Load nintendo font
+    PlFontData standard, extended, chinese;
+    static ImWchar extended_range[] = {0xe000, 0xe152, 0};
+    if (R_FAILED(plGetSharedFontByType(&standard,    PlSharedFontType_Standard)) ||
+            R_FAILED(plGetSharedFontByType(&extended, PlSharedFontType_NintendoExt)) ||
+            R_FAILED(plGetSharedFontByType(&chinese,  PlSharedFontType_ChineseSimplified)))
+        return false;
+
+    // build font atlas, or load it from the cache on the sd card
+    // the chinese font only contributes the glyphs in ranges that the standard one lacks
+    io.Fonts->Clear();
+    io.Fonts->Flags |= ImFontAtlasFlags_NoPowerOfTwoHeight | ImFontAtlasFlags_NoMouseCursors;
+    auto rc = ft::build(*io.Fonts, {
+        { standard.address, standard.size, 20.0f, io.Fonts->GetGlyphRangesDefault() },
+        { extended.address, extended.size, 20.0f, extended_range                    },
+        { chinese.address,  chinese.size,  20.0f, ranges                            },
+    });
+    if (R_FAILED(rc)) {
+        printf("Failed to build font atlas: %#x\n", rc);
+        return false;
+    }
+
+    return true;
+}
+
+void imgui::nx::setOperationModeCallback(std::function<void()> callback) {
+    s_operationModeCallback = std::move(callback);
+}
+
 void imgui::nx::newFrame() {
     auto &io = ImGui::GetIO();
 
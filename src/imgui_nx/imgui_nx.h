@@ -27,10 +27,19 @@
 
 #pragma once
 
+#include <functional>
+#include <imgui.h>
+
 namespace imgui::nx {
 
 bool init();
 void exit();
 void newFrame();
 
+// Rebuilds the atlas, the chinese font being limited to ranges. Must not be called between NewFrame and Render
+bool buildFonts(const ImWchar *ranges);
+
+// Called from the applet hook after switching between docked and handheld, outside of any frame
+void setOperationModeCallback(std::function<void()> callback);
+
 } // namespace imgui::nx
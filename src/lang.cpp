@@ -15,80 +15,165 @@
 // You should have received a copy of the GNU General Public License
 // along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <switch.h>
-#include <json.hpp>
+#include <cstdio>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#endif
 
 #include "fs.hpp"
 #include "lang.hpp"
 
-using json = nlohmann::json;
-
 namespace lang {
 
 namespace {
 
-static json lang_json = nullptr;
-static Language current_language = Language::Default;
+constexpr std::size_t num_languages = static_cast<std::size_t>(Language::Default);
+
+constexpr std::array<const char *, num_languages> table_paths = {
+    "romfs:/lang/en.bin",
+    "romfs:/lang/ch.bin",
+    "romfs:/lang/fr.bin",
+    "romfs:/lang/nl.bin",
+    "romfs:/lang/it.bin",
+    "romfs:/lang/de.bin",
+    "romfs:/lang/es.bin",
+};
+
+// Every table in a single allocation, never modified once published
+struct Tables {
+    std::vector<std::uint8_t>                       arena;
+    std::array<const std::uint8_t *, num_languages> tables = {};
+};
+
+static Tables                      preloaded_tables;
+static std::atomic<const Tables *> tables_ptr       = nullptr;
+static std::atomic<Language>       current_language = Language::Default;
+
+// Joined on exit in case the application quits before waiting
+static struct Preloader {
+    std::thread thread;
+
+    ~Preloader() {
+        if (this->thread.joinable())
+            this->thread.join();
+    }
+} preloader;
 
-} // namespace
+constexpr std::size_t get_index(Language lang) {
+    return (lang < Language::Default) ? static_cast<std::size_t>(lang) : static_cast<std::size_t>(Language::English);
+}
 
-const json &get_json() {
-    return lang_json;
+const std::uint32_t *get_offsets(const std::uint8_t *table) {
+    return reinterpret_cast<const std::uint32_t *>(table + sizeof(TableHeader));
 }
 
-Language get_current_language() {
-    return current_language;
+const GlyphRange *get_ranges(const std::uint8_t *table) {
+    return reinterpret_cast<const GlyphRange *>(get_offsets(table) + num_keys + 1);
 }
 
-Result set_language(Language lang) {
-    const char *path;
-    current_language = lang;
-    switch (lang) {
-        case Language::Chinese:
-            path = "romfs:/lang/ch.json";
-            break;
-        case Language::French:
-            path = "romfs:/lang/fr.json";
-            break;
-        case Language::Dutch:
-            path = "romfs:/lang/nl.json";
-            break;
-        case Language::Italian:
-            path = "romfs:/lang/it.json";
-            break;
-        case Language::German:
-            path = "romfs:/lang/de.json";
-            break;
-        case Language::Spanish:
-            path = "romfs:/lang/es.json";
-            break;
-        case Language::English:
-        case Language::Default:
-        default:
-            path = "romfs:/lang/en.json";
-            break;
-    }
+const char *get_pool(const std::uint8_t *table) {
+    auto *header = reinterpret_cast<const TableHeader *>(table);
+    return reinterpret_cast<const char *>(get_ranges(table) + header->num_ranges);
+}
 
-    auto *fp = fopen(path, "r");
-    if (!fp)
-        return 1;
+bool is_valid_table(const std::uint8_t *table, std::size_t size) {
+    if (size < sizeof(TableHeader))
+        return false;
+
+    auto *header = reinterpret_cast<const TableHeader *>(table);
+    if ((header->magic != table_magic) || (header->num_keys != num_keys) || (header->keys_hash != hash_keys()))
+        return false;
+
+    auto offsets_size = (num_keys + 1) * sizeof(std::uint32_t), ranges_size = header->num_ranges * sizeof(GlyphRange);
+    if (size != sizeof(TableHeader) + offsets_size + ranges_size + header->pool_size)
+        return false;
+
+    // Every string must lie in the pool and be null-terminated
+    auto *offsets = get_offsets(table);
+    auto *pool    = get_pool(table);
+    for (std::size_t i = 0; i < num_keys; ++i)
+        if ((offsets[i] >= offsets[i + 1]) || (offsets[i + 1] > header->pool_size) || (pool[offsets[i + 1] - 1] != 0))
+            return false;
+    return true;
+}
 
-    fseek(fp, 0, SEEK_END);
-    std::size_t size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+const std::uint8_t *get_current_table() {
+    auto *tables = tables_ptr.load(std::memory_order_acquire);
+    return tables ? tables->tables[get_index(current_language.load(std::memory_order_relaxed))] : nullptr;
+}
 
-    std::string contents(size, 0);
+void preload_tables() {
+    auto &res = preloaded_tables;
+
+    std::array<FILE *, num_languages> files = {};
+    std::array<std::size_t, num_languages> sizes = {}, offsets = {};
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < num_languages; ++i) {
+        if (!(files[i] = fopen(table_paths[i], "rb"))) {
+            printf("Failed to open language table %s\n", table_paths[i]);
+            continue;
+        }
+        fseek(files[i], 0, SEEK_END);
+        sizes[i] = ftell(files[i]);
+        fseek(files[i], 0, SEEK_SET);
+
+        // Keep the offset tables aligned
+        offsets[i] = total, total += (sizes[i] + alignof(std::uint32_t) - 1) & ~(alignof(std::uint32_t) - 1);
+    }
+
+    res.arena.resize(total);
+    for (std::size_t i = 0; i < num_languages; ++i) {
+        if (!files[i])
+            continue;
+
+        auto *table = res.arena.data() + offsets[i];
+        auto read   = fread(table, 1, sizes[i], files[i]);
+        fclose(files[i]);
+        if ((read == sizes[i]) && is_valid_table(table, sizes[i]))
+            res.tables[i] = table;
+        else
+            printf("Invalid language table %s\n", table_paths[i]);
+    }
 
-    if (auto read = fread(contents.data(), 1, size, fp); read != size)
-        return read;
-    fclose(fp);
+    tables_ptr.store(&res, std::memory_order_release);
+}
 
-    lang_json = json::parse(contents);
+} // namespace
 
+Result preload() {
+    if (preloader.thread.joinable() || tables_ptr.load(std::memory_order_acquire))
+        return 0;
+    preloader.thread = std::thread(preload_tables);
     return 0;
 }
 
+void wait_preload() {
+    if (preloader.thread.joinable())
+        preloader.thread.join();
+}
+
+Language get_current_language() {
+    return current_language.load(std::memory_order_relaxed);
+}
+
+Result set_language(Language lang) {
+    current_language.store(lang, std::memory_order_relaxed);
+
+    // Takes effect once the tables are published if they are still loading
+    auto *tables = tables_ptr.load(std::memory_order_acquire);
+    return (!tables || tables->tables[get_index(lang)]) ? 0 : 1;
+}
+
 Result initialize_to_system_language() {
+#ifndef __SWITCH__
+    // Host builds only run the tests
+    return set_language(Language::Default);
+#else
     if (auto rc = setInitialize(); R_FAILED(rc)) {
         setExit();
         return rc;
@@ -126,10 +211,24 @@ Result initialize_to_system_language() {
         default:
             return set_language(Language::Default);
     }
+#endif
 }
 
-std::string get_string(std::string key, const json &json) {
-    return json.value(key, key);
+std::string_view get_string(std::size_t key) {
+    auto *table = get_current_table();
+    if (!table)
+        return get_fallback(key);
+
+    auto *offsets = get_offsets(table);
+    return std::string_view(get_pool(table) + offsets[key], offsets[key + 1] - offsets[key] - 1);
+}
+
+GlyphRanges get_glyph_ranges() {
+    auto *table = get_current_table();
+    if (!table)
+        return { &base_glyph_range, 1 };
+
+    return { get_ranges(table), reinterpret_cast<const TableHeader *>(table)->num_ranges };
 }
 
 } // namespace lang
@@ -17,8 +17,16 @@
 
 #pragma once
 
-#include <string>
-#include <json.hpp>
+#include <cstdint>
+#include <string_view>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#else
+#   include "fs.hpp" // Result
+#endif
+
+#include "lang_keys.hpp"
 
 namespace lang {
 
@@ -33,18 +41,37 @@ enum class Language {
     Default,
 };
 
-const nlohmann::json &get_json();
+// Loads every language table on a background thread, after which switching language does no I/O
+Result preload();
+void wait_preload();
 
 Language get_current_language();
 Result set_language(Language lang);
 Result initialize_to_system_language();
 
-std::string get_string(std::string key, const nlohmann::json &json = get_json());
+// The returned views are null-terminated and stay valid for the lifetime of the application
+std::string_view get_string(std::size_t key);
+
+struct GlyphRanges {
+    const GlyphRange *ranges;
+    std::size_t       count;
+
+    constexpr const GlyphRange *begin() const { return this->ranges;               }
+    constexpr const GlyphRange *end()   const { return this->ranges + this->count; }
+};
+
+// Characters needed to display the current language, valid for the lifetime of the application
+GlyphRanges get_glyph_ranges();
 
 namespace literals {
 
-inline std::string operator ""_lang(const char *key, size_t size) {
-    return get_string(std::string(key, size));
+// Resolves the key at compile time, so lookups are only an index into the table
+template <typename C, C ...Cs>
+inline std::string_view operator ""_lang() {
+    constexpr C name[] = { Cs..., 0 };
+    constexpr auto key = find_key(std::string_view(name, sizeof...(Cs)));
+    static_assert(key < num_keys, "Unknown language key");
+    return get_string(key);
 }
 
 } // namespace literals
@@ -0,0 +1,148 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <string_view>
+
+// Shared between the application and tools/lang2bin, which compiles res/lang/*.json into string tables
+namespace lang {
+
+// Keys of nested objects are joined with a dot
+constexpr std::array<std::string_view, 51> keys = {
+    "app_name",
+    "version",
+
+    "turnips",
+    "visitors",
+    "weather",
+    "language",
+
+    "last_save_time",
+    "save_outdated",
+    "save_check",
+    "save_check_running",
+    "save_check_ok",
+    "save_check_corrupt",
+    "save_check_unknown",
+
+    "days.sunday",
+    "days.monday",
+    "days.tuesday",
+    "days.wednesday",
+    "days.thursday",
+    "days.friday",
+    "days.saturday",
+
+    "am",
+    "pm",
+
+    "price_pattern",
+    "next_week_odds",
+    "next_week_prices",
+    "turnips_max",
+    "turnips_min",
+    "turnips_average",
+    "week_graph",
+    "turnips_patterns.fluctuating",
+    "turnips_patterns.large_spike",
+    "turnips_patterns.decreasing",
+    "turnips_patterns.small_spike",
+
+    "npcs.none",
+    "npcs.gulliver",
+    "npcs.label",
+    "npcs.saharah",
+    "npcs.wisp",
+    "npcs.celeste",
+    "npcs.mabel",
+    "npcs.cj",
+    "npcs.flick",
+    "npcs.kicks",
+    "npcs.leif",
+    "npcs.redd",
+    "npcs.gullivarrr",
+
+    "hemisphere",
+    "weather_seed",
+    "weather_url_tip",
+    "hemispheres.northern",
+    "hemispheres.southern",
+};
+
+constexpr std::size_t num_keys = keys.size();
+
+// Shown in the language tab whatever the current language is, in the order of lang::Language
+constexpr std::array<const char *, 7> language_names = {
+    "English",
+    "中文",
+    "Français",
+    "Nederlands",
+    "Italiano",
+    "Deutsch",
+    "Español",
+};
+
+struct GlyphRange {
+    std::uint32_t first, last;
+};
+
+// Basic Latin and Latin-1 Supplement, always in the font atlas so numbers and save data can be displayed
+constexpr GlyphRange base_glyph_range = { 0x20, 0xff };
+
+// Returns num_keys for unknown keys
+constexpr std::size_t find_key(std::string_view key) {
+    for (std::size_t i = 0; i < num_keys; ++i)
+        if (keys[i] == key)
+            return i;
+    return num_keys;
+}
+
+// Name shown when a language lacks a string, the last component of the key
+constexpr std::string_view get_fallback(std::size_t key) {
+    auto name = keys[key];
+    return name.substr(name.rfind('.') + 1);
+}
+
+constexpr std::uint32_t hash_keys() {
+    std::uint32_t hash = 0x811c9dc5;
+    for (auto key: keys) {
+        for (auto c: key)
+            hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x01000193;
+        hash *= 0x01000193; // Null terminator
+    }
+    return hash;
+}
+
+// Table layout: header, num_keys + 1 offsets into the pool, the sorted glyph ranges needed to display the language,
+// then the pool of null-terminated strings. The hash of the key list rejects tables built against another version of this file
+struct TableHeader {
+    std::array<char, 4> magic;
+    std::uint32_t       num_keys;
+    std::uint32_t       keys_hash;
+    std::uint32_t       num_ranges;
+    std::uint32_t       pool_size;
+};
+
+constexpr std::array<char, 4> table_magic = { 'T', 'L', 'N', 'G' };
+
+static_assert(sizeof(TableHeader) == 0x14);
+
+} // namespace lang
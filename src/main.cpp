@@ -17,23 +17,29 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <atomic>
+#include <thread>
 #include <utility>
 #include <switch.h>
-#include <math.h>
 #include <imgui.h>
 
+#include "alloc.hpp"
+#include "bench.hpp"
 #include "fs.hpp"
 #include "gui.hpp"
+#include "hash.hpp"
+#include "history.hpp"
 #include "lang.hpp"
 #include "save.hpp"
 #include "theme.hpp"
 #include "parser.hpp"
-
-using namespace lang::literals;
+#include "view.hpp"
 
 constexpr static auto acnh_programid = 0x01006f8002326000ul;
 constexpr static auto save_main_path = "/main.dat";
 constexpr static auto save_hdr_path  = "/mainHeader.dat";
+constexpr static auto history_path   = "/switch/Turnips/history.bin";
+constexpr static auto layouts_path   = "/switch/Turnips/layouts.bin";
 
 extern "C" void userAppInit() {
     setsysInitialize();
@@ -54,8 +60,111 @@ extern "C" void userAppExit() {
 #endif
 }
 
+// Verifies the hashes of main.dat on request, as it needs the whole file decrypted.
+// The save is opened again on a thread of its own, so the gui keeps running meanwhile
+class SaveCheck {
+    private:
+        std::thread                 thread;
+        std::atomic<vm::CheckState> state = vm::CheckState::Idle;
+        hs::Report                  report;
+
+    public:
+        ~SaveCheck() {
+            if (this->thread.joinable())
+                this->thread.join();
+        }
+
+        void start(tp::Version version) {
+            if (this->thread.joinable())
+                this->thread.join();
+
+            this->state.store(vm::CheckState::Running, std::memory_order_relaxed);
+            this->thread = std::thread([this, version] {
+                this->report = run(version);
+                auto state = !this->report.known_layout ? vm::CheckState::Unknown :
+                    this->report.corrupt.empty() ? vm::CheckState::Ok : vm::CheckState::Corrupt;
+                this->state.store(state, std::memory_order_release);
+            });
+        }
+
+        inline vm::CheckState get_state() const {
+            return this->state.load(std::memory_order_acquire);
+        }
+
+        // Only valid once the check is done
+        inline const hs::Report &get_report() const {
+            return this->report;
+        }
+
+    private:
+        static hs::Report run(tp::Version version) {
+            FsFileSystem handle;
+            auto rc = fsOpen_DeviceSaveData(&handle, acnh_programid);
+            auto fs = fs::Filesystem(handle);
+            if (R_FAILED(rc)) {
+                printf("Failed to open save: %#x\n", rc);
+                return {};
+            }
+            fs::File header, main;
+            if (rc = fs.open_file(header, save_hdr_path) | fs.open_file(main, save_main_path); R_FAILED(rc)) {
+                printf("Failed to open save files: %#x\n", rc);
+                return {};
+            }
+
+            printf("Verifying save hashes...\n");
+            auto [key, ctr] = sv::get_keys(header);
+            auto plain   = sv::decrypt_parallel(main, main.size(), key, ctr);
+            auto learned = load_shape(version);
+            auto report  = hs::check_main(version, plain.data(), plain.size(), learned);
+            if (!report.known_layout)
+                printf("Could not locate the hash regions of the save\n");
+            for (auto &region: report.corrupt)
+                printf("Hash mismatch in region %#x-%#zx\n", region.hash_offset, region.end());
+
+            // Keep the shape of an intact save, so a corrupt one of the same revision can be checked later
+            if (report.known_layout && report.corrupt.empty() && (report.shape != learned))
+                if (auto rc = store_shape(version, report.shape); R_FAILED(rc))
+                    printf("Failed to store save layout: %#x\n", rc);
+            return report;
+        }
+
+        // The file holds one shape per revision, zeroed until learned
+        static hs::MainShape load_shape(tp::Version version) {
+            hs::MainShape shape = {};
+            fs::File file;
+            if (auto sd = fs::Filesystem(); R_SUCCEEDED(sd.open_sdmc()) && R_SUCCEEDED(sd.open_file(file, layouts_path)))
+                if (file.read(&shape, sizeof(shape), static_cast<std::size_t>(version) * sizeof(shape)) != sizeof(shape))
+                    shape = {};
+            return shape;
+        }
+
+        static Result store_shape(tp::Version version, const hs::MainShape &shape) {
+            auto sd = fs::Filesystem();
+            auto rc = sd.open_sdmc();
+            if (R_FAILED(rc))
+                return rc;
+            if (!sd.is_file(layouts_path))
+                sd.create_file(layouts_path, static_cast<std::size_t>(tp::Version::Total) * sizeof(shape));
+
+            fs::File file;
+            if (rc = sd.open_file(file, layouts_path, FsOpenMode_Write); R_FAILED(rc))
+                return rc;
+            if (rc = file.write(&shape, sizeof(shape), static_cast<std::size_t>(version) * sizeof(shape)); R_SUCCEEDED(rc))
+                file.flush();
+            return rc;
+        }
+};
+
 int main(int argc, char **argv) {
+#ifdef BENCHMARK
+    bench::run_all();
+#endif
+
+    // Read the language tables while the save is decrypted
+    lang::preload();
+
     tp::TurnipParser turnip_parser; tp::VisitorParser visitor_parser; tp::DateParser date_parser; tp::WeatherSeedParser seed_parser;
+    auto version = tp::Version::Total;
     {
         printf("Opening save...\n");
         FsFileSystem handle;
@@ -73,22 +182,41 @@ int main(int argc, char **argv) {
 
         printf("Deriving keys...\n");
         auto [key, ctr] = sv::get_keys(header);
-        printf("Decrypting save...\n");
-        auto decrypted  = sv::decrypt(main, 0xc00000, key, ctr);
 
         printf("Parsing save...\n");
-        auto version_parser = tp::VersionParser(header);
-        turnip_parser  = tp::TurnipParser     (static_cast<tp::Version>(version_parser), decrypted);
-        visitor_parser = tp::VisitorParser    (static_cast<tp::Version>(version_parser), decrypted);
-        date_parser    = tp::DateParser       (static_cast<tp::Version>(version_parser), decrypted);
-        seed_parser    = tp::WeatherSeedParser(static_cast<tp::Version>(version_parser), decrypted);
+        version = static_cast<tp::Version>(tp::VersionParser(header));
+        if (appletGetAppletType() == AppletType_Application) {
+            auto image = sv::SaveImage(main, key, ctr);
+            turnip_parser  = tp::TurnipParser     (version, image);
+            visitor_parser = tp::VisitorParser    (version, image);
+            date_parser    = tp::DateParser       (version, image);
+            seed_parser    = tp::WeatherSeedParser(version, image);
+        } else {
+            // Applet mode leaves little heap, only pull the structures we need out of the save
+            auto data = tp::extract(version, main, key, ctr);
+            turnip_parser  = tp::TurnipParser     (data.version, data.prices);
+            visitor_parser = tp::VisitorParser    (data.version, data.schedule);
+            date_parser    = tp::DateParser       (data.version, data.date);
+            seed_parser    = tp::WeatherSeedParser(data.version, data.info);
+        }
     }
 
     auto save_date = date_parser.date;
     auto save_ts   = date_parser.to_posix();
 
+    if (auto sd = fs::Filesystem(); R_SUCCEEDED(sd.open_sdmc()) && save_ts) {
+        hist::History history;
+        auto snapshot = hist::Snapshot{ save_ts, turnip_parser.prices, visitor_parser.schedule.npcs, seed_parser.calculate_weather_seed() };
+        auto rc = history.open(sd, history_path);
+        if (R_SUCCEEDED(rc))
+            rc = history.append(snapshot);
+        if (R_FAILED(rc))
+            printf("Failed to record save history: %#x\n", rc);
+    }
+
     if (auto rc = lang::initialize_to_system_language(); R_FAILED(rc))
         printf("Failed to init language: %#x, will fall back to key names\n", rc);
+    lang::wait_preload();
 
     printf("Starting gui\n");
     if (!gui::init())
@@ -103,7 +231,30 @@ int main(int argc, char **argv) {
     else
         th::apply_theme(th::Theme::Dark);
 
-    while (gui::loop()) {
+    // Applet mode leaves too little heap to decrypt the whole save
+    auto views = vm::Views(turnip_parser, visitor_parser, seed_parser, save_date, save_ts,
+        appletGetAppletType() == AppletType_Application);
+    auto save_check = SaveCheck();
+    auto check_state = vm::CheckState::Idle;
+
+#ifdef DEBUG
+    auto frame_counter = al::FrameCounter();
+    al::enable_trace(true);
+    frame_counter.begin();
+#endif
+
+    bool language_changed = false;
+    while (true) {
+        // The glyphs of a new language are built before the frame starts, so its first frame renders with them.
+        // The atlas can't change once ImGui started the frame
+        if (language_changed) {
+            gui::update_fonts();
+            views.invalidate(vm::Views::Language);
+        }
+
+        if (!gui::loop())
+            break;
+
         u64 ts = 0;
         auto rc = timeGetCurrentTime(TimeType_UserSystemClock, &ts);
         if (R_FAILED(rc))
@@ -115,34 +266,29 @@ int main(int argc, char **argv) {
         if (R_FAILED(rc))
             printf("Failed to convert timestamp\n");
 
-        bool is_outdated = (floor(ts / (24 * 60 * 60)) > floor(save_ts / (24 * 60 * 60)) + cal_info.wday)
-            && ((cal_info.wday != 0) || (cal_time.hour >= 5));
-
-        auto &[width, height] = im::GetIO().DisplaySize;
-
-        im::SetNextWindowFocus();
-        im::Begin(std::string("app_name"_lang + ", " + "version"_lang + " " + VERSION + "-" + COMMIT + "###main").c_str(), nullptr,
-            ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoMove);
-        im::SetWindowPos({0.23f * width, 0.16f * height});
-        im::SetWindowSize({0.55f * width, 0.73f * height});
-
-        im::Text("last_save_time"_lang.c_str(),
-            save_date.day, save_date.month, save_date.year, save_date.hour, save_date.minute, save_date.second);
-        if (is_outdated)
-            im::SameLine(), gui::do_with_color(th::text_min_col, [] { im::TextUnformatted("save_outdated"_lang.c_str()); });
-
-        im::BeginTabBar("##tab_bar", ImGuiTabBarFlags_NoTooltip);
-
-        gui::draw_turnip_tab(turnip_parser, cal_time, cal_info);
-        gui::draw_visitor_tab(visitor_parser, cal_time, cal_info);
-        gui::draw_weather_tab(seed_parser);
-        gui::draw_language_tab();
+        if (auto state = save_check.get_state(); state != check_state) {
+            auto &report = save_check.get_report();
+            if ((state == vm::CheckState::Ok) || (state == vm::CheckState::Corrupt))
+                views.set_check(state, report.corrupt.size(), report.num_regions);
+            else
+                views.set_check(state);
+            check_state = state;
+        }
 
-        im::EndTabBar();
+        views.set_time(ts, cal_info.wday, cal_time.hour);
+        views.update();
 
-        im::End();
+        auto actions = gui::draw_main_window(views);
+        if (actions.check_save)
+            save_check.start(version);
+        language_changed = actions.language_changed;
 
         gui::render();
+
+#ifdef DEBUG
+        al::report(frame_counter, frame_counter.end());
+        frame_counter.begin();
+#endif
     }
 
     gui::exit();
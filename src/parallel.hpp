@@ -0,0 +1,87 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#endif
+
+namespace par {
+
+// Applications get cores 0 to 2, the last one is reserved to the system
+inline std::size_t core_count() {
+#ifdef __SWITCH__
+    return 3;
+#else
+    return std::max(std::thread::hardware_concurrency(), 1u);
+#endif
+}
+
+// Threads are created on the default core of the process and never migrate, so spread them manually
+inline void pin_to_core(std::size_t idx) {
+#ifdef __SWITCH__
+    auto core = static_cast<std::int32_t>(idx % core_count());
+    svcSetThreadCoreMask(CUR_THREAD_HANDLE, core, 1u << core);
+#else
+    (void)idx;
+#endif
+}
+
+// Splits [0, count) in contiguous slices with boundaries aligned to `align`,
+// and calls f(begin, end, idx) for each of them on its own thread
+template <typename F>
+void for_slices(std::size_t count, std::size_t num_threads, std::size_t align, F &&f) {
+    num_threads = std::clamp(num_threads, 1ul, std::max((count + align - 1) / align, 1ul));
+    auto slice  = ((count + num_threads - 1) / num_threads + align - 1) / align * align;
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (std::size_t i = 1; i < num_threads; ++i) {
+        auto begin = std::min(i * slice, count), end = std::min(begin + slice, count);
+        threads.emplace_back([&f, begin, end, i] {
+            pin_to_core(i);
+            f(begin, end, i);
+        });
+    }
+
+    f(0, std::min(slice, count), 0);
+
+    for (auto &thread: threads)
+        thread.join();
+}
+
+// Calls f(i, idx) for each i in [0, count), every thread taking the next index as soon as it is done with the previous one.
+// Suited to items of uneven cost, which should be ordered from most to least expensive
+template <typename F>
+void for_each(std::size_t count, std::size_t num_threads, F &&f) {
+    num_threads = std::clamp(num_threads, 1ul, std::max(count, 1ul));
+
+    std::atomic_size_t next = 0;
+    for_slices(num_threads, num_threads, 1, [&](std::size_t, std::size_t, std::size_t idx) {
+        for (std::size_t i; (i = next++) < count;)
+            f(i, idx);
+    });
+}
+
+} // namespace par
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <cstdint>
+#include <ctime>
 #include <array>
 #include <algorithm>
 #include <type_traits>
@@ -25,7 +26,9 @@
 #include <vector>
 
 #include "fs.hpp"
+#include "hash.hpp"
 #include "lang.hpp"
+#include "save.hpp"
 
 namespace tp {
 
@@ -41,6 +44,8 @@ enum class Version: std::size_t {
     Total = Unknown,
 };
 
+static_assert(hs::impl::main_shapes.size() == static_cast<std::size_t>(Version::Total));
+
 struct VersionInfo {
     std::uint32_t major = 0, minor = 0;
     std::uint16_t unk_1 = 0, header_rev = 0, unk_2 = 0, save_rev = 0;
@@ -161,10 +166,10 @@ class TurnipParser {
         };
 
         constexpr static std::array turnip_patterns = {
-            "fluctuating",
-            "large_spike",
-            "decreasing",
-            "small_spike",
+            lang::find_key("turnips_patterns.fluctuating"),
+            lang::find_key("turnips_patterns.large_spike"),
+            lang::find_key("turnips_patterns.decreasing"),
+            lang::find_key("turnips_patterns.small_spike"),
         };
 
         static_assert(turnip_offsets.size() == static_cast<std::size_t>(Version::Total));
@@ -175,20 +180,25 @@ class TurnipParser {
 
     public:
         constexpr TurnipParser() = default;
-        TurnipParser(Version version, const std::vector<std::uint8_t> &save): version(version), prices(this->get_prices(save)) { }
+        TurnipParser(Version version, sv::SaveImage &save): version(version), prices(this->get_prices(save)) { }
+        constexpr TurnipParser(Version version, const TurnipPrices &prices): version(version), prices(prices) { }
 
-        inline std::string get_pattern() const {
-            return lang::get_string(this->turnip_patterns[this->prices.pattern_type], lang::get_json()["turnips_patterns"]);
+        constexpr static inline std::size_t get_offset(Version version) {
+            return (version != Version::Unknown) ? turnip_offsets[static_cast<std::size_t>(version)] : 0ul;
         }
 
-    private:
-        inline std::size_t get_tp_offset() const {
-            return (this->version != Version::Unknown) ? this->turnip_offsets[static_cast<std::size_t>(this->version)] : 0ul;
+        static inline std::string_view get_pattern_name(std::uint32_t pattern) {
+            return lang::get_string(turnip_patterns[pattern]);
+        }
+
+        inline std::string_view get_pattern() const {
+            return get_pattern_name(this->prices.pattern_type);
         }
 
-        inline TurnipPrices get_prices(const std::vector<std::uint8_t> &save) const {
-            if (auto offset = this->get_tp_offset(); offset != 0ul)
-                return *reinterpret_cast<const TurnipPrices *>(&save[offset]);
+    private:
+        inline TurnipPrices get_prices(sv::SaveImage &save) const {
+            if (auto offset = get_offset(this->version); offset != 0ul)
+                return save.read<TurnipPrices>(offset);
             else
                 return {};
         }
@@ -207,18 +217,18 @@ class VisitorParser {
         };
 
         constexpr static std::array visitor_names = {
-            "none",
-            "gulliver",
-            "label",
-            "saharah",
-            "wisp",
-            "mabel",
-            "cj",
-            "flick",
-            "kicks",
-            "leif",
-            "redd",
-            "gullivarrr"
+            lang::find_key("npcs.none"),
+            lang::find_key("npcs.gulliver"),
+            lang::find_key("npcs.label"),
+            lang::find_key("npcs.saharah"),
+            lang::find_key("npcs.wisp"),
+            lang::find_key("npcs.mabel"),
+            lang::find_key("npcs.cj"),
+            lang::find_key("npcs.flick"),
+            lang::find_key("npcs.kicks"),
+            lang::find_key("npcs.leif"),
+            lang::find_key("npcs.redd"),
+            lang::find_key("npcs.gullivarrr"),
         };
 
         static_assert(visitor_offsets.size() == static_cast<std::size_t>(Version::Total));
@@ -229,13 +239,18 @@ class VisitorParser {
 
     public:
         constexpr VisitorParser() = default;
-        VisitorParser(Version version, const std::vector<std::uint8_t> &save): version(version), schedule(this->get_schedule((save))) { }
+        VisitorParser(Version version, sv::SaveImage &save): version(version), schedule(this->get_schedule(save)) { }
+        constexpr VisitorParser(Version version, const VisitorSchedule &schedule): version(version), schedule(schedule) { }
+
+        constexpr static inline std::size_t get_offset(Version version) {
+            return (version != Version::Unknown) ? visitor_offsets[static_cast<std::size_t>(version)] : 0ul;
+        }
 
-        inline std::array<std::string, 7> get_visitor_names() const {
-            std::array<std::string, 7> names;
+        inline std::array<std::string_view, 7> get_visitor_names() const {
+            std::array<std::string_view, 7> names;
             std::transform(this->schedule.npcs.begin(), this->schedule.npcs.end(), names.begin(),
                 [this](std::uint32_t visitor) {
-                    return lang::get_string(this->visitor_names[visitor], lang::get_json()["npcs"]);
+                    return lang::get_string(this->visitor_names[visitor]);
                 }
             );
             return names;
@@ -250,13 +265,9 @@ class VisitorParser {
         }
 
     private:
-        inline std::size_t get_vs_offset() const {
-            return (this->version != Version::Unknown) ? this->visitor_offsets[static_cast<std::size_t>(this->version)] : 0ul;
-        }
-
-        inline VisitorSchedule get_schedule(const std::vector<std::uint8_t> &save) const {
-            if (auto offset = this->get_vs_offset(); offset != 0ul)
-                return *reinterpret_cast<const VisitorSchedule *>(&save[offset]);
+        inline VisitorSchedule get_schedule(sv::SaveImage &save) const {
+            if (auto offset = get_offset(this->version); offset != 0ul)
+                return save.read<VisitorSchedule>(offset);
             else
                 return {};
         }
@@ -282,22 +293,31 @@ class DateParser {
 
     public:
         constexpr DateParser() = default;
-        DateParser(Version version, const std::vector<std::uint8_t> &save): version(version), date(this->get_date((save))) { }
+        DateParser(Version version, sv::SaveImage &save): version(version), date(this->get_date(save)) { }
+        constexpr DateParser(Version version, const Date &date): version(version), date(date) { }
+
+        constexpr static inline std::size_t get_offset(Version version) {
+            return (version != Version::Unknown) ? date_offsets[static_cast<std::size_t>(version)] : 0ul;
+        }
 
         inline std::uint64_t to_posix() const {
             std::uint64_t ts = 0;
+#ifdef __SWITCH__
             timeToPosixTimeWithMyRule(reinterpret_cast<const TimeCalendarTime *>(&this->date), &ts, 1, nullptr);
+#else
+            // Host builds have no timezone rule, take the date as UTC
+            std::tm tm = {};
+            tm.tm_year = this->date.year - 1900, tm.tm_mon = this->date.month - 1, tm.tm_mday = this->date.day;
+            tm.tm_hour = this->date.hour, tm.tm_min = this->date.minute, tm.tm_sec = this->date.second;
+            ts = timegm(&tm);
+#endif
             return ts;
         }
 
     private:
-        inline std::size_t get_date_offset() const {
-            return (this->version != Version::Unknown) ? this->date_offsets[static_cast<std::size_t>(this->version)] : 0ul;
-        }
-
-        inline Date get_date(const std::vector<std::uint8_t> &save) const {
-            if (auto offset = this->get_date_offset(); offset != 0ul)
-                return *reinterpret_cast<const Date *>(&save[offset]);
+        inline Date get_date(sv::SaveImage &save) const {
+            if (auto offset = get_offset(this->version); offset != 0ul)
+                return save.read<Date>(offset);
             else
                 return {};
         }
@@ -318,8 +338,8 @@ class WeatherSeedParser {
         constexpr static std::uint32_t weather_seed_max = 2147483647;
 
         constexpr static std::array hemisphere_names = {
-            "northern",
-            "southern",
+            lang::find_key("hemispheres.northern"),
+            lang::find_key("hemispheres.southern"),
         };
 
         static_assert(info_offsets.size() == static_cast<std::size_t>(Version::Total));
@@ -330,27 +350,58 @@ class WeatherSeedParser {
 
     public:
         constexpr WeatherSeedParser() = default;
-        WeatherSeedParser(Version version, const std::vector<std::uint8_t> &save): version(version), info(this->get_info((save))) { }
+        WeatherSeedParser(Version version, sv::SaveImage &save): version(version), info(this->get_info(save)) { }
+        constexpr WeatherSeedParser(Version version, const WeatherInfo &info): version(version), info(info) { }
+
+        constexpr static inline std::size_t get_offset(Version version) {
+            return (version != Version::Unknown) ? info_offsets[static_cast<std::size_t>(version)] : 0ul;
+        }
 
         constexpr inline std::uint32_t calculate_weather_seed() const {
             return this->info.raw_seed - this->weather_seed_max - 1;
         }
 
-        inline std::string get_hemisphere_name() const {
-            return lang::get_string(this->hemisphere_names[this->info.hemisphere], lang::get_json()["hemispheres"]);
+        inline std::string_view get_hemisphere_name() const {
+            return lang::get_string(this->hemisphere_names[this->info.hemisphere]);
         }
 
     private:
-        inline std::size_t get_info_offset() const {
-            return (this->version != Version::Unknown) ? this->info_offsets[static_cast<std::size_t>(this->version)] : 0ul;
-        }
-
-        inline WeatherInfo get_info(const std::vector<std::uint8_t> &save) const {
-            if (auto offset = this->get_info_offset(); offset != 0ul)
-                return *reinterpret_cast<const WeatherInfo *>(&save[offset]);
+        inline WeatherInfo get_info(sv::SaveImage &save) const {
+            if (auto offset = get_offset(this->version); offset != 0ul)
+                return save.read<WeatherInfo>(offset);
             else
                 return {};
         }
 };
 
+// Everything the parsers need from the main save file
+struct SaveData {
+    Version         version  = Version::Unknown;
+    TurnipPrices    prices   = {};
+    VisitorSchedule schedule = {};
+    Date            date     = {};
+    WeatherInfo     info     = {};
+};
+
+// Streams the structures out of the encrypted save without building a decrypted image, for low-memory environments
+inline SaveData extract(Version version, fs::File &main,
+        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr) {
+    SaveData data;
+    if (version == Version::Unknown)
+        return data;
+
+    auto ranges = std::vector<sv::Range>{
+        { TurnipParser::get_offset(version),      sizeof(data.prices),   &data.prices   },
+        { VisitorParser::get_offset(version),     sizeof(data.schedule), &data.schedule },
+        { DateParser::get_offset(version),        sizeof(data.date),     &data.date     },
+        { WeatherSeedParser::get_offset(version), sizeof(data.info),     &data.info     },
+    };
+
+    if (!sv::read_ranges(main, key, ctr, std::move(ranges)))
+        return {};
+
+    data.version = version;
+    return data;
+}
+
 } // namespace tp
@@ -0,0 +1,752 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "search.hpp"
+#include "sead.hpp"
+
+namespace pr {
+
+// Same values as TurnipPrices::pattern_type
+enum class Pattern: std::uint32_t {
+    Fluctuating,
+    LargeSpike,
+    Decreasing,
+    SmallSpike,
+    FirstWeek,      // Stored until the first week is rolled, which is always Decreasing
+    Unknown,
+    Total = FirstWeek,
+};
+
+constexpr std::size_t num_patterns  = static_cast<std::size_t>(Pattern::Total);
+constexpr std::size_t num_half_days = 12; // Monday AM to Saturday PM
+
+using Odds = std::array<float, num_patterns>;
+
+// Chances in percent of next week's pattern, indexed by this week's. From Ninji's reverse-engineering of the game
+constexpr std::array<std::array<std::uint32_t, num_patterns>, num_patterns> transitions = {{
+    { 20, 30, 15, 35 },
+    { 50,  5, 20, 25 },
+    { 25, 45,  5, 25 },
+    { 45, 25, 15, 15 },
+}};
+
+namespace impl {
+
+// Long-run odds of each pattern, used when last week's is not known
+constexpr Odds make_stationary_odds() {
+    Odds odds = { 0.25f, 0.25f, 0.25f, 0.25f };
+    for (int i = 0; i < 100; ++i) {
+        Odds next = {};
+        for (std::size_t from = 0; from < num_patterns; ++from)
+            for (std::size_t to = 0; to < num_patterns; ++to)
+                next[to] += odds[from] * transitions[from][to] / 100.0f;
+        odds = next;
+    }
+    return odds;
+}
+
+constexpr inline Odds stationary_odds = make_stationary_odds();
+
+} // namespace impl
+
+constexpr inline Odds get_next_odds(Pattern current) {
+    if (current == Pattern::Unknown)
+        return impl::stationary_odds;
+    if (current == Pattern::FirstWeek)
+        return { 0.0f, 0.0f, 1.0f, 0.0f };
+
+    Odds odds = {};
+    for (std::size_t i = 0; i < num_patterns; ++i)
+        odds[i] = transitions[static_cast<std::size_t>(current)][i] / 100.0f;
+    return odds;
+}
+
+// What is known about the week, prices set to 0 are unknown
+struct Observations {
+    std::uint32_t                              buy_price = 0;
+    std::array<std::uint32_t, num_half_days>   prices    = {};
+    Pattern                                    previous  = Pattern::Unknown, current = Pattern::Unknown;
+
+    constexpr inline bool operator ==(const Observations &other) const {
+        for (std::size_t i = 0; i < this->prices.size(); ++i)
+            if (this->prices[i] != other.prices[i])
+                return false;
+        return (this->buy_price == other.buy_price) && (this->previous == other.previous) && (this->current == other.current);
+    }
+
+    constexpr inline bool operator !=(const Observations &other) const {
+        return !(*this == other);
+    }
+};
+
+struct Band {
+    std::uint32_t min = 0, max = 0;
+    std::uint32_t low = 0, median = 0, high = 0; // 10th, 50th and 90th percentiles
+};
+
+struct Prediction {
+    bool                               is_consistent = false;
+    Odds                               pattern_odds  = {}, next_odds = {};
+    std::array<Band, num_half_days>    bands         = {};
+};
+
+namespace impl {
+
+constexpr std::uint32_t min_base_price = 90, max_base_price = 110;
+constexpr std::uint32_t max_price      = 6 * max_base_price + 1;
+
+// One choice of the discrete parameters of a pattern, with its probability within the pattern
+struct Structure {
+    Pattern       pattern;
+    std::uint32_t a, b, c;
+    float         odds;
+};
+
+constexpr std::size_t num_structures = 2 * 28 + 7 + 1 + 8;
+
+constexpr std::array<Structure, num_structures> make_structures() {
+    std::array<Structure, num_structures> res = {};
+    std::size_t i = 0;
+
+    // Length of the first decreasing phase, of the first high phase, and of the last high phase
+    for (std::uint32_t dec_1 = 2; dec_1 <= 3; ++dec_1)
+        for (std::uint32_t hi_1 = 0; hi_1 <= 6; ++hi_1)
+            for (std::uint32_t hi_3 = 0; hi_3 < 7 - hi_1; ++hi_3)
+                res[i++] = { Pattern::Fluctuating, dec_1, hi_1, hi_3, 1.0f / 2 / 7 / (7 - hi_1) };
+
+    // Start of the peak
+    for (std::uint32_t peak = 3; peak <= 9; ++peak)
+        res[i++] = { Pattern::LargeSpike, peak, 0, 0, 1.0f / 7 };
+
+    res[i++] = { Pattern::Decreasing, 0, 0, 0, 1.0f };
+
+    for (std::uint32_t peak = 2; peak <= 9; ++peak)
+        res[i++] = { Pattern::SmallSpike, peak, 0, 0, 1.0f / 8 };
+
+    return res;
+}
+
+constexpr inline std::array<Structure, num_structures> structures = make_structures();
+
+// Replays the generator of a structure through a walker, mirroring the game's code.
+// Each random draw is tied to the price it determines, so walkers can condition it on that price
+template <typename Walker>
+void walk(const Structure &s, Walker &w) {
+    std::size_t day = 0;
+
+    auto decreasing = [&](std::size_t len, float lo, float hi, float dec, float dec_rand) {
+        for (std::size_t i = 0; i < len; ++i, ++day) {
+            if (i == 0)
+                w.chain(day, lo, hi);
+            else
+                w.decrease(day, dec, dec_rand);
+        }
+    };
+
+    auto high = [&](std::size_t len, float lo, float hi) {
+        for (std::size_t i = 0; i < len; ++i, ++day)
+            w.independent(day, lo, hi);
+    };
+
+    switch (s.pattern) {
+        case Pattern::Fluctuating: {
+            auto dec_1 = s.a, dec_2 = 5 - s.a, hi_1 = s.b, hi_3 = s.c, hi_2 = 7 - hi_1 - hi_3;
+            high(hi_1, 0.9f, 1.4f);
+            decreasing(dec_1, 0.6f, 0.8f, 0.04f, 0.06f);
+            high(hi_2, 0.9f, 1.4f);
+            decreasing(dec_2, 0.6f, 0.8f, 0.04f, 0.06f);
+            high(hi_3, 0.9f, 1.4f);
+            break;
+        }
+        case Pattern::LargeSpike:
+            decreasing(s.a - 2, 0.85f, 0.9f, 0.03f, 0.02f);
+            high(1, 0.9f, 1.4f);
+            high(1, 1.4f, 2.0f);
+            high(1, 2.0f, 6.0f);
+            high(1, 1.4f, 2.0f);
+            high(1, 0.9f, 1.4f);
+            high(num_half_days - day, 0.4f, 0.9f);
+            break;
+        case Pattern::Decreasing:
+            decreasing(num_half_days, 0.85f, 0.9f, 0.03f, 0.02f);
+            break;
+        case Pattern::SmallSpike:
+            decreasing(s.a - 2, 0.4f, 0.9f, 0.03f, 0.02f);
+            high(2, 0.9f, 1.4f);
+            w.spike(day, 1.4f, 2.0f), day += 3;
+            decreasing(num_half_days - day, 0.4f, 0.9f, 0.03f, 0.02f);
+            break;
+        default:
+            break;
+    }
+}
+
+inline std::uint32_t intceil(float val) {
+    return static_cast<std::uint32_t>(val + 0.99999f);
+}
+
+struct Interval {
+    float lo, hi;
+
+    constexpr inline float length() const {
+        return std::max(this->hi - this->lo, 0.0f);
+    }
+
+    constexpr inline bool is_empty() const {
+        return this->lo > this->hi;
+    }
+
+    constexpr inline Interval operator &(const Interval &other) const {
+        return { std::max(this->lo, other.lo), std::min(this->hi, other.hi) };
+    }
+};
+
+// Rates producing a given price, with a bit of slack for the float arithmetic of the game
+inline Interval rates_for(std::uint32_t price, std::uint32_t base) {
+    constexpr float slack = 0.001f;
+    return { (price - 0.99999f - slack) / base, (price + 0.00001f + slack) / base };
+}
+
+// Propagates the range of each rate, giving the exact min and max of every price, and whether the observations fit at all
+struct BoundsWalker {
+    std::uint32_t base;
+    const std::array<std::uint32_t, num_half_days> &obs;
+
+    bool is_feasible = true;
+    Interval rate = {};
+    std::array<std::uint32_t, num_half_days> min = {}, max = {};
+
+    inline void emit(std::size_t day, Interval r, int offset = 0) {
+        if (auto price = this->obs[day]; price) {
+            r = r & rates_for(price - offset, this->base);
+            if (r.is_empty())
+                this->is_feasible = false;
+            this->min[day] = this->max[day] = price;
+        } else {
+            this->min[day] = intceil(r.lo * this->base) + offset, this->max[day] = intceil(r.hi * this->base) + offset;
+        }
+    }
+
+    inline void independent(std::size_t day, float lo, float hi) {
+        this->emit(day, { lo, hi });
+    }
+
+    inline void chain(std::size_t day, float lo, float hi) {
+        this->rate = { lo, hi };
+        this->constrain(day);
+    }
+
+    inline void decrease(std::size_t day, float dec, float dec_rand) {
+        this->rate = { this->rate.lo - dec - dec_rand, this->rate.hi - dec };
+        this->constrain(day);
+    }
+
+    // The peak rate bounds the prices on both sides of it, which in turn bound the peak rate from below
+    inline void spike(std::size_t day, float lo, float hi) {
+        Interval peak = { lo, hi };
+        if (auto price = this->obs[day + 1]; price)
+            peak = peak & rates_for(price, this->base);
+        for (auto side: { day, day + 2 }) {
+            if (auto price = this->obs[side]; price)
+                peak.lo = std::max(peak.lo, rates_for(price + 1, this->base).lo);
+        }
+
+        if (peak.is_empty()) {
+            this->is_feasible = false;
+            return;
+        }
+
+        this->emit(day,     { lo, peak.hi }, -1);
+        this->emit(day + 1, peak);
+        this->emit(day + 2, { lo, peak.hi }, -1);
+    }
+
+    private:
+        inline void constrain(std::size_t day) {
+            if (auto price = this->obs[day]; price)
+                this->rate = this->rate & rates_for(price, this->base);
+            if (this->rate.is_empty())
+                this->is_feasible = false;
+            this->emit(day, this->rate);
+        }
+};
+
+// Draws every price, each draw restricted to the values matching an observation with the sample weighted by the chance of hitting them
+struct SampleWalker {
+    std::uint32_t base;
+    const std::array<std::uint32_t, num_half_days> &obs;
+    sead::Random &rng;
+
+    float weight = 1.0f, rate = 0.0f;
+    std::array<std::uint32_t, num_half_days> prices = {};
+
+    inline float uniform(Interval r) {
+        return r.lo + r.length() * static_cast<float>(this->rng.get_u32() >> 8) / (1 << 24);
+    }
+
+    inline float draw(std::size_t day, Interval r, int offset = 0) {
+        if (auto price = this->obs[day]; price) {
+            auto hit = r & rates_for(price - offset, this->base);
+            this->weight *= (r.length() > 0.0f) ? hit.length() / r.length() : !hit.is_empty();
+            r = hit;
+        }
+        return this->uniform(r);
+    }
+
+    inline void set_price(std::size_t day, float rate, int offset = 0) {
+        this->prices[day] = this->obs[day] ? this->obs[day] : intceil(rate * this->base) + offset;
+    }
+
+    inline void independent(std::size_t day, float lo, float hi) {
+        this->set_price(day, this->draw(day, { lo, hi }));
+    }
+
+    inline void chain(std::size_t day, float lo, float hi) {
+        this->rate = this->draw(day, { lo, hi });
+        this->set_price(day, this->rate);
+    }
+
+    inline void decrease(std::size_t day, float dec, float dec_rand) {
+        this->rate = this->draw(day, { this->rate - dec - dec_rand, this->rate - dec });
+        this->set_price(day, this->rate);
+    }
+
+    // Draws are independent so the peak can be drawn before the sides, which depend on it
+    inline void spike(std::size_t day, float lo, float hi) {
+        auto peak = this->draw(day + 1, { lo, hi });
+        this->set_price(day + 1, peak);
+        this->set_price(day,     this->draw(day,     { lo, peak }, -1), -1);
+        this->set_price(day + 2, this->draw(day + 2, { lo, peak }, -1), -1);
+    }
+};
+
+} // namespace impl
+
+// Enumerates every pattern and parameter combination of the game's turnip generator, and keeps those consistent with the observations.
+// Bounds are exact, percentiles come from a fixed-seed weighted sampling of the remaining combinations.
+// The last prediction is kept, so it can be queried every frame
+class Predictor {
+    public:
+        constexpr static std::size_t samples_per_structure = 64;
+
+    private:
+        Observations obs;
+        Prediction   cached;
+        bool         has_cached = false;
+
+    public:
+        const Prediction &predict(const Observations &obs) {
+            if (!this->has_cached || (obs != this->obs))
+                this->cached = compute(obs), this->obs = obs, this->has_cached = true;
+            return this->cached;
+        }
+
+        static Prediction compute(const Observations &obs) {
+            using namespace impl;
+
+            Prediction res;
+            std::vector<std::array<float, max_price + 1>> histograms(num_half_days);
+            std::array<std::uint32_t, num_half_days> min, max;
+            min.fill(UINT32_MAX), max.fill(0);
+
+            auto prior = (obs.previous == Pattern::Unknown) ? stationary_odds : get_next_odds(obs.previous);
+            auto rng   = sead::Random(0x7a1b);
+
+            auto base_lo = obs.buy_price ? obs.buy_price : min_base_price, base_hi = obs.buy_price ? obs.buy_price : max_base_price;
+            float total = 0.0f;
+            for (auto base = base_lo; base <= base_hi; ++base) {
+                for (auto &s: structures) {
+                    if ((obs.current != Pattern::Unknown) && (s.pattern != obs.current))
+                        continue;
+
+                    auto bounds = BoundsWalker{ base, obs.prices };
+                    walk(s, bounds);
+                    if (!bounds.is_feasible)
+                        continue;
+
+                    auto odds = prior[static_cast<std::size_t>(s.pattern)] * s.odds / (base_hi - base_lo + 1);
+                    float structure_weight = 0.0f;
+                    for (std::size_t i = 0; i < samples_per_structure; ++i) {
+                        auto sample = SampleWalker{ base, obs.prices, rng };
+                        walk(s, sample);
+                        if (sample.weight <= 0.0f)
+                            continue;
+
+                        auto weight = odds * sample.weight / samples_per_structure;
+                        structure_weight += weight;
+                        for (std::size_t day = 0; day < num_half_days; ++day)
+                            histograms[day][std::min(sample.prices[day], max_price)] += weight;
+                    }
+
+                    if (structure_weight <= 0.0f)
+                        continue;
+
+                    res.pattern_odds[static_cast<std::size_t>(s.pattern)] += structure_weight;
+                    total += structure_weight;
+                    for (std::size_t day = 0; day < num_half_days; ++day)
+                        min[day] = std::min(min[day], bounds.min[day]), max[day] = std::max(max[day], bounds.max[day]);
+                }
+            }
+
+            if (total <= 0.0f) {
+                res.next_odds = get_next_odds(obs.current);
+                return res;
+            }
+
+            res.is_consistent = true;
+            for (std::size_t i = 0; i < num_patterns; ++i) {
+                res.pattern_odds[i] /= total;
+                auto next = get_next_odds(static_cast<Pattern>(i));
+                for (std::size_t j = 0; j < num_patterns; ++j)
+                    res.next_odds[j] += res.pattern_odds[i] * next[j];
+            }
+
+            for (std::size_t day = 0; day < num_half_days; ++day) {
+                auto &band = res.bands[day];
+                band.min = min[day], band.max = max[day];
+
+                auto percentile = [&](float p) -> std::uint32_t {
+                    float acc = 0.0f;
+                    for (std::uint32_t price = 0; price <= max_price; ++price) {
+                        if ((acc += histograms[day][price]) >= p * total)
+                            return std::clamp(price, band.min, band.max);
+                    }
+                    return band.max;
+                };
+                band.low = percentile(0.1f), band.median = percentile(0.5f), band.high = percentile(0.9f);
+            }
+
+            return res;
+        }
+};
+
+// A week as generated by the game
+struct Week {
+    std::uint32_t                              base_price = 0;
+    Pattern                                    pattern    = Pattern::Unknown;
+    std::array<std::uint32_t, num_half_days>   prices     = {};
+};
+
+namespace impl {
+
+// Helpers of the game's generator, from Ninji's reverse-engineering
+struct GameRandom {
+    sead::Random rng;
+
+    inline std::uint32_t randint(std::uint32_t min, std::uint32_t max) {
+        return ((static_cast<std::uint64_t>(this->rng.get_u32()) * (max - min + 1)) >> 32) + min;
+    }
+
+    inline float randfloat(float a, float b) {
+        std::uint32_t val = 0x3f800000 | (this->rng.get_u32() >> 9);
+        float f;
+        std::memcpy(&f, &val, sizeof(f));
+        return a + ((f - 1.0f) * (b - a));
+    }
+
+    inline bool randbool() {
+        return this->rng.get_u32() & 0x80000000;
+    }
+};
+
+inline std::uint32_t game_intceil(float val) {
+    return static_cast<std::int32_t>(val + 0.99999f);
+}
+
+// Inclusive range of raw outputs for which randint(min, max) falls within [lo, hi]
+constexpr inline std::pair<std::uint32_t, std::uint32_t> randint_outputs(std::uint32_t min, std::uint32_t max, std::uint32_t lo, std::uint32_t hi) {
+    auto range = static_cast<std::uint64_t>(max - min + 1);
+    auto first = (((static_cast<std::uint64_t>(lo - min)) << 32) + range - 1) / range;
+    auto last  = (((static_cast<std::uint64_t>(hi - min + 1)) << 32) + range - 1) / range - 1;
+    return { static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(last) };
+}
+
+// Range of the `chance` roll leading from one pattern to another
+constexpr inline std::pair<std::uint32_t, std::uint32_t> transition_chances(Pattern from, Pattern to) {
+    std::uint32_t lo = 0;
+    for (std::size_t i = 0; i < static_cast<std::size_t>(to); ++i)
+        lo += transitions[static_cast<std::size_t>(from)][i];
+    return { lo, lo + transitions[static_cast<std::size_t>(from)][static_cast<std::size_t>(to)] - 1 };
+}
+
+} // namespace impl
+
+// Replays the game's generator for a seed, and stops at the first value contradicting the observations.
+// Written after Ninji's port, float arithmetic included, so prices match the game exactly
+inline bool replay(std::uint32_t seed, Pattern previous, const Observations &obs, Week *week = nullptr) {
+    auto rng = impl::GameRandom{ sead::Random(seed) };
+    auto w = Week{};
+
+    w.base_price = rng.randint(90, 110);
+    if (obs.buy_price && (w.base_price != obs.buy_price))
+        return false;
+
+    // The roll is made even when the previous pattern doesn't use it
+    auto chance = rng.randint(0, 99);
+    if (previous == Pattern::FirstWeek) {
+        w.pattern = Pattern::Decreasing;
+    } else if (previous < Pattern::FirstWeek) {
+        for (std::size_t i = 0, acc = 0; i < num_patterns; ++i) {
+            acc += transitions[static_cast<std::size_t>(previous)][i];
+            if (chance < acc) {
+                w.pattern = static_cast<Pattern>(i);
+                break;
+            }
+        }
+    }
+    if ((obs.current != Pattern::Unknown) && (w.pattern != obs.current))
+        return false;
+
+    std::size_t day = 0;
+    auto emit = [&](std::uint32_t price) {
+        w.prices[day] = price;
+        auto expected = obs.prices[day++];
+        return !expected || (expected == price);
+    };
+    auto base = static_cast<float>(w.base_price);
+    float rate;
+
+    switch (w.pattern) {
+        case Pattern::Fluctuating: {
+            std::uint32_t dec_1 = rng.randbool() ? 3 : 2, dec_2 = 5 - dec_1;
+            auto hi_1 = rng.randint(0, 6), hi_23 = 7 - hi_1, hi_3 = rng.randint(0, hi_23 - 1);
+
+            for (std::uint32_t i = 0; i < hi_1; ++i)
+                if (!emit(impl::game_intceil(rng.randfloat(0.9, 1.4) * base)))
+                    return false;
+
+            rate = rng.randfloat(0.8, 0.6);
+            for (std::uint32_t i = 0; i < dec_1; ++i) {
+                if (!emit(impl::game_intceil(rate * base)))
+                    return false;
+                rate -= 0.04;
+                rate -= rng.randfloat(0, 0.06);
+            }
+
+            for (std::uint32_t i = 0; i < hi_23 - hi_3; ++i)
+                if (!emit(impl::game_intceil(rng.randfloat(0.9, 1.4) * base)))
+                    return false;
+
+            rate = rng.randfloat(0.8, 0.6);
+            for (std::uint32_t i = 0; i < dec_2; ++i) {
+                if (!emit(impl::game_intceil(rate * base)))
+                    return false;
+                rate -= 0.04;
+                rate -= rng.randfloat(0, 0.06);
+            }
+
+            for (std::uint32_t i = 0; i < hi_3; ++i)
+                if (!emit(impl::game_intceil(rng.randfloat(0.9, 1.4) * base)))
+                    return false;
+            break;
+        }
+        case Pattern::LargeSpike: {
+            auto peak = rng.randint(3, 9);
+
+            rate = rng.randfloat(0.9, 0.85);
+            for (std::uint32_t i = 2; i < peak; ++i) {
+                if (!emit(impl::game_intceil(rate * base)))
+                    return false;
+                rate -= 0.03;
+                rate -= rng.randfloat(0, 0.02);
+            }
+
+            for (auto [lo, hi]: { std::pair{ 0.9f, 1.4f }, { 1.4f, 2.0f }, { 2.0f, 6.0f }, { 1.4f, 2.0f }, { 0.9f, 1.4f } })
+                if (!emit(impl::game_intceil(rng.randfloat(lo, hi) * base)))
+                    return false;
+
+            while (day < num_half_days)
+                if (!emit(impl::game_intceil(rng.randfloat(0.4, 0.9) * base)))
+                    return false;
+            break;
+        }
+        case Pattern::Decreasing:
+            rate = 0.9;
+            rate -= rng.randfloat(0, 0.05);
+            while (day < num_half_days) {
+                if (!emit(impl::game_intceil(rate * base)))
+                    return false;
+                rate -= 0.03;
+                rate -= rng.randfloat(0, 0.02);
+            }
+            break;
+        case Pattern::SmallSpike: {
+            auto peak = rng.randint(2, 9);
+
+            rate = rng.randfloat(0.9, 0.4);
+            for (std::uint32_t i = 2; i < peak; ++i) {
+                if (!emit(impl::game_intceil(rate * base)))
+                    return false;
+                rate -= 0.03;
+                rate -= rng.randfloat(0, 0.02);
+            }
+
+            for (std::uint32_t i = 0; i < 2; ++i)
+                if (!emit(impl::game_intceil(rng.randfloat(0.9, 1.4) * base)))
+                    return false;
+
+            rate = rng.randfloat(1.4, 2.0);
+            if (!emit(impl::game_intceil(rng.randfloat(1.4, rate) * base) - 1) || !emit(impl::game_intceil(rate * base))
+                    || !emit(impl::game_intceil(rng.randfloat(1.4, rate) * base) - 1))
+                return false;
+
+            if (day < num_half_days) {
+                rate = rng.randfloat(0.9, 0.4);
+                while (day < num_half_days) {
+                    if (!emit(impl::game_intceil(rate * base)))
+                        return false;
+                    rate -= 0.03;
+                    rate -= rng.randfloat(0, 0.02);
+                }
+            }
+            break;
+        }
+        default:
+            return false;
+    }
+
+    if (week)
+        *week = w;
+    return true;
+}
+
+// Replays a seed with every possible previous pattern when it is not known, the first week included
+inline bool replay_any(std::uint32_t seed, const Observations &obs, Week *week = nullptr) {
+    if (obs.previous != Pattern::Unknown)
+        return replay(seed, obs.previous, obs, week);
+
+    for (std::size_t i = 0; i <= static_cast<std::size_t>(Pattern::FirstWeek); ++i)
+        if (replay(seed, static_cast<Pattern>(i), obs, week))
+            return true;
+    return false;
+}
+
+// Recovers the seeds of a week from its observed prices, by walking the whole 32-bit seed space.
+// The first draws are checked for all lanes at once against the raw output ranges giving the observed buy price and pattern,
+// the few surviving seeds are then replayed one by one until a price differs.
+// The space is covered in segments, and the state between them can be saved to resume a search later
+class SeedSearch {
+    public:
+        constexpr static std::size_t   lanes        = 8;
+        constexpr static std::uint64_t segment_size = 1ull << 26;
+        constexpr static std::uint64_t seed_count   = 1ull << 32;
+
+        constexpr static std::uint32_t checkpoint_magic = 0x53535054; // "TPSS"
+
+        struct CheckpointHeader {
+            std::uint32_t                              magic;
+            std::uint32_t                              buy_price;
+            std::array<std::uint32_t, num_half_days>   prices;
+            Pattern                                    previous, current;
+            std::uint64_t                              next;
+            std::uint32_t                              num_seeds;
+        };
+
+    private:
+        Observations               obs;
+        std::atomic_uint64_t       next      = 0;
+        std::atomic_size_t         num_found = 0;
+        std::vector<std::uint32_t> seeds;
+
+    public:
+        SeedSearch(const Observations &obs): obs(obs) { }
+
+        inline bool is_done() const {
+            return this->next >= seed_count;
+        }
+
+        inline const std::vector<std::uint32_t> &get_seeds() const {
+            return this->seeds;
+        }
+
+        // Safe to poll from another thread during a search, unlike get_seeds
+        inline std::size_t get_num_found() const {
+            return this->num_found;
+        }
+
+        inline float fraction(const sr::Progress &progress) const {
+            return (this->next + progress.done) / static_cast<float>(seed_count);
+        }
+
+        // Searches the next segment, returns false if cancelled before its end
+        bool step(sr::Progress &progress, std::size_t num_threads = par::core_count()) {
+            auto [base_lo, base_hi] = this->obs.buy_price ?
+                impl::randint_outputs(90, 110, this->obs.buy_price, this->obs.buy_price) : std::pair{ 0u, UINT32_MAX };
+            auto [chance_lo, chance_hi] = ((this->obs.previous < Pattern::FirstWeek) && (this->obs.current < Pattern::FirstWeek)) ?
+                impl::transition_chances(this->obs.previous, this->obs.current) : std::pair{ 0u, 99u };
+            auto [roll_lo, roll_hi] = impl::randint_outputs(0, 99, chance_lo, chance_hi);
+
+            auto end   = std::min(this->next + segment_size, seed_count);
+            auto found = sr::search<lanes>(this->next, end, [&](std::uint32_t first) -> std::uint64_t {
+                auto rng = sead::RandomN<lanes>(first);
+                auto base = rng.get_u32(), roll = rng.get_u32();
+                auto candidates = (base >= base_lo) & (base <= base_hi) & (roll >= roll_lo) & (roll <= roll_hi);
+
+                std::uint64_t mask = 0;
+                for (std::size_t i = 0; i < lanes; ++i)
+                    if (candidates[i] && replay_any(first + i, this->obs))
+                        mask |= std::uint64_t(1) << i;
+                return mask;
+            }, progress, num_threads);
+
+            if (progress.cancelled)
+                return false;
+
+            this->seeds.insert(this->seeds.end(), found.begin(), found.end());
+            this->num_found = this->seeds.size(), this->next = end;
+            return true;
+        }
+
+        std::vector<std::uint8_t> save_checkpoint() const {
+            auto hdr = CheckpointHeader{ checkpoint_magic, this->obs.buy_price, this->obs.prices,
+                this->obs.previous, this->obs.current, this->next.load(), static_cast<std::uint32_t>(this->seeds.size()) };
+
+            std::vector<std::uint8_t> res(sizeof(hdr) + this->seeds.size() * sizeof(std::uint32_t));
+            std::memcpy(res.data(), &hdr, sizeof(hdr));
+            std::memcpy(res.data() + sizeof(hdr), this->seeds.data(), this->seeds.size() * sizeof(std::uint32_t));
+            return res;
+        }
+
+        // Checkpoints of a search on different observations are rejected
+        bool load_checkpoint(const std::vector<std::uint8_t> &data) {
+            CheckpointHeader hdr;
+            if (data.size() < sizeof(hdr))
+                return false;
+            std::memcpy(&hdr, data.data(), sizeof(hdr));
+
+            auto hdr_obs = Observations{ hdr.buy_price, hdr.prices, hdr.previous, hdr.current };
+            if ((hdr.magic != checkpoint_magic) || (hdr_obs != this->obs) || (hdr.next > seed_count)
+                    || (data.size() != sizeof(hdr) + hdr.num_seeds * sizeof(std::uint32_t)))
+                return false;
+
+            this->seeds.resize(hdr.num_seeds);
+            std::memcpy(this->seeds.data(), data.data() + sizeof(hdr), hdr.num_seeds * sizeof(std::uint32_t));
+            this->num_found = hdr.num_seeds, this->next = hdr.next;
+            return true;
+        }
+};
+
+} // namespace pr
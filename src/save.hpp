@@ -20,60 +20,504 @@
 #include <cstdint>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
-#include <switch.h>
-
+#include "aes.hpp"
+#include "crypt.hpp"
 #include "fs.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
 #include "sead.hpp"
 
 namespace sv {
 
-// From NHSE
-static std::array<std::uint8_t, 0x10> get_param(const std::vector<std::uint32_t> &crypt_data, std::size_t idx) {
-    auto sead = sead::Random(crypt_data[crypt_data[idx] & 0x7f]);
-    auto roll_count = (crypt_data[crypt_data[idx + 1] & 0x7f] & 0xf) + 1;
-
-    for (std::uint32_t i = 0; i < roll_count; ++i)
-        sead.get_u64();
+// Failures of the save handling itself, errors of the filesystem calls are passed through as they are
+constexpr std::uint32_t result_module = 420;
 
-    std::array<std::uint8_t, 0x10> res;
-    for (std::size_t i = 0; i < res.size(); i++)
-        res[i] = sead.get_u32() >> 24;
-    return res;
-}
+enum Error: Result {
+    Error_ShortRead     = MAKERESULT(result_module, 1), // A file is smaller than the data expected from it
+    Error_UnknownLayout = MAKERESULT(result_module, 2), // The image does not match the hash layout of its revision
+};
 
-static std::pair<std::array<std::uint8_t, 0x10>, std::array<std::uint8_t, 0x10>> get_keys(fs::File &header) {
+inline std::pair<std::array<std::uint8_t, 0x10>, std::array<std::uint8_t, 0x10>> get_keys(fs::File &header) {
     constexpr std::size_t crypt_data_size = 0x200;
 
     std::vector<std::uint32_t> crypt_data(0x200, 0);
     if (auto read = header.read(crypt_data.data(), crypt_data.size(), 0x100); read != crypt_data_size)
         printf("Failed to read header encryption data (got %#lx bytes, expected %#lx)\n", read, crypt_data_size);
 
-    auto key = get_param(crypt_data, 0);
-    auto ctr = get_param(crypt_data, 2);
-    return {std::move(key), std::move(ctr)};
+    return get_keys(crypt_data);
 }
 
-static std::vector<std::uint8_t> decrypt(fs::File &main, std::size_t size,
-        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> ctr) {
-    Aes128CtrContext ctx;
-    aes128CtrContextCreate(&ctx, key.data(), ctr.data());
-
-    std::size_t offset = 0, read = 0, buf_size = std::clamp(size, 0x1000ul, 0x80000ul);
-    std::vector<std::uint8_t> buf(buf_size, 0);
-    std::vector<std::uint8_t> res(size, 0);
-
-    while (offset < size) {
-        read = main.read(buf.data(), buf.size(), offset);
-        aes128CtrCrypt(&ctx, &res[offset], buf.data(), read);
-        offset += read;
-        if (read != buf.size())
-            break;
+// Destination for a part of the decrypted save
+struct Range {
+    std::size_t offset, size;
+    void *dst;
+};
+
+// Decrypts only the blocks covering the requested ranges, in a single pass over the file with a small fixed-size buffer
+inline bool read_ranges(fs::File &main, const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr,
+        std::vector<Range> ranges) {
+    constexpr std::size_t buf_size = 0x4000; // 16 KiB
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range &lhs, const Range &rhs) { return lhs.offset < rhs.offset; });
+
+    std::vector<std::uint8_t> buf(buf_size);
+    auto ctx = aes::Ctr(key, ctr);
+
+    for (std::size_t i = 0, pos = 0; i < ranges.size();) {
+        // Cover as many of the following ranges as the buffer allows
+        auto begin = std::max(pos, ranges[i].offset) & ~0xful, end = begin;
+        for (auto j = i; (j < ranges.size()) && (ranges[j].offset < begin + buf_size); ++j)
+            end = std::max(end, ranges[j].offset + ranges[j].size);
+        end = std::min((end + 0xf) & ~0xful, begin + buf_size);
+
+        if (auto read = main.read(buf.data(), end - begin, begin); read != end - begin) {
+            printf("Failed to read save at %#lx (got %#lx bytes, expected %#lx)\n", begin, read, end - begin);
+            return false;
+        }
+
+        ctx.reset(ctr_at(ctr, begin));
+        ctx.crypt(buf.data(), buf.data(), end - begin);
+
+        for (auto j = i; (j < ranges.size()) && (ranges[j].offset < end); ++j) {
+            auto &range = ranges[j];
+            auto from = std::max(range.offset, begin), to = std::min(range.offset + range.size, end);
+            if (from < to)
+                std::copy(&buf[from - begin], &buf[to - begin], static_cast<std::uint8_t *>(range.dst) + (from - range.offset));
+        }
+
+        pos = end;
+        while ((i < ranges.size()) && (ranges[i].offset + ranges[i].size <= pos))
+            ++i;
     }
 
-    return res;
+    return true;
+}
+
+// Decrypted view of a save file, decrypting pages on first access and keeping the most recently used ones around.
+// Modified pages stay resident until they are committed back to the file
+class SaveImage {
+    public:
+        constexpr static std::size_t page_size = 0x10000; // 64 KiB
+        constexpr static std::size_t num_pages = 4;
+
+        static_assert(page_size % 0x10 == 0, "Pages must be aligned to the AES block size");
+
+    private:
+        struct Page {
+            std::size_t               index    = -1ul;
+            std::size_t               size     = 0;
+            std::uint64_t             last_use = 0;
+            bool                      dirty    = false;
+            std::vector<std::uint8_t> data;
+        };
+
+        fs::File &file;
+        std::size_t file_size;
+        std::array<std::uint8_t, 0x10> ctr;
+        aes::Ctr ctx;
+
+        std::vector<Page> pages;
+        std::uint64_t tick = 0;
+
+        // Sorted, non-overlapping [begin, end) ranges of modified bytes
+        std::vector<std::pair<std::size_t, std::size_t>> dirty;
+
+    public:
+        SaveImage(fs::File &file, const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr):
+                file(file), file_size(file.size()), ctr(ctr), ctx(key, ctr) {
+            this->pages.reserve(num_pages);
+        }
+
+        inline std::size_t size() const {
+            return this->file_size;
+        }
+
+        inline const std::vector<std::pair<std::size_t, std::size_t>> &dirty_ranges() const {
+            return this->dirty;
+        }
+
+        std::size_t read(void *buf, std::size_t size, std::size_t offset) {
+            auto *dst = static_cast<std::uint8_t *>(buf);
+            std::size_t done = 0;
+            while (done < size) {
+                auto &page = this->get_page((offset + done) / page_size);
+                auto page_off = (offset + done) % page_size;
+                if (page_off >= page.size)
+                    break;
+
+                auto count = std::min(size - done, page.size - page_off);
+                std::copy_n(page.data.data() + page_off, count, dst + done);
+                done += count;
+            }
+            return done;
+        }
+
+        template <typename T>
+        T read(std::size_t offset) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T res = {};
+            if (auto read = this->read(&res, sizeof(T), offset); read != sizeof(T))
+                printf("Failed to read save image at %#lx (got %#lx bytes, expected %#lx)\n", offset, read, sizeof(T));
+            return res;
+        }
+
+        std::size_t write(const void *buf, std::size_t size, std::size_t offset) {
+            auto *src = static_cast<const std::uint8_t *>(buf);
+            std::size_t done = 0;
+            while (done < size) {
+                auto &page = this->get_page((offset + done) / page_size);
+                auto page_off = (offset + done) % page_size;
+                if (page_off >= page.size)
+                    break;
+
+                auto count = std::min(size - done, page.size - page_off);
+                std::copy_n(src + done, count, page.data.data() + page_off);
+                page.dirty = true;
+                done += count;
+            }
+
+            if (done)
+                this->mark_dirty(offset, offset + done);
+            return done;
+        }
+
+        template <typename T>
+        void write(const T &val, std::size_t offset) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (auto written = this->write(&val, sizeof(T), offset); written != sizeof(T))
+                printf("Failed to write save image at %#lx (wrote %#lx bytes, expected %#lx)\n", offset, written, sizeof(T));
+        }
+
+        // Refreshes the hashes of the modified regions, then re-encrypts the blocks covering modified bytes with the original
+        // key and counter, and writes them back in place. An image not matching the layout is refused, as the game
+        // would reject the save on the next load.
+        // The save filesystem only makes writes visible once committed, so an interrupted commit leaves the previous save.
+        // A failed write is undone from a copy of the previous ciphertext, since closing the filesystem would commit it;
+        // the image keeps its modifications so the commit can be retried
+        Result commit(fs::Filesystem &save_fs, const hs::Layout &layout) {
+            if (this->dirty.empty())
+                return 0;
+
+            if (!layout.is_known() || (layout.file_size != this->file_size)) {
+                printf("Refusing to commit a save with an unknown layout\n");
+                return Error_UnknownLayout;
+            }
+            hs::update_dirty(layout, *this);
+
+            std::vector<std::pair<std::size_t, std::size_t>> extents;
+            for (auto [begin, end]: this->dirty) {
+                begin &= ~0xful, end = std::min((end + 0xf) & ~0xful, this->file_size);
+                if (!extents.empty() && (begin <= extents.back().second))
+                    extents.back().second = std::max(extents.back().second, end);
+                else
+                    extents.emplace_back(begin, end);
+            }
+
+            std::size_t total = 0;
+            for (auto [begin, end]: extents)
+                total += end - begin;
+
+            std::vector<std::uint8_t> previous(total);
+            for (std::size_t i = 0, pos = 0; i < extents.size(); pos += extents[i].second - extents[i].first, ++i) {
+                auto [begin, end] = extents[i];
+                if (auto read = this->file.read(previous.data() + pos, end - begin, begin); read != end - begin) {
+                    printf("Failed to read save at %#lx (got %#lx bytes, expected %#lx)\n", begin, read, end - begin);
+                    return Error_ShortRead;
+                }
+            }
+
+            auto restore = [&](std::size_t count) {
+                for (std::size_t i = 0, pos = 0; i < count; pos += extents[i].second - extents[i].first, ++i) {
+                    if (auto rc = this->file.write(previous.data() + pos, extents[i].second - extents[i].first, extents[i].first); R_FAILED(rc))
+                        printf("Failed to restore save at %#lx: %#x\n", extents[i].first, rc);
+                }
+            };
+
+            std::vector<std::uint8_t> buf;
+            for (std::size_t i = 0; i < extents.size(); ++i) {
+                auto [begin, end] = extents[i];
+                buf.resize(end - begin);
+                this->read(buf.data(), buf.size(), begin);
+                this->ctx.reset(ctr_at(this->ctr, begin));
+                this->ctx.crypt(buf.data(), buf.data(), buf.size());
+                if (auto rc = this->file.write(buf.data(), buf.size(), begin); R_FAILED(rc)) {
+                    restore(i + 1);
+                    return rc;
+                }
+            }
+
+            if (auto rc = save_fs.flush(); R_FAILED(rc)) {
+                restore(extents.size());
+                return rc;
+            }
+
+            this->dirty.clear();
+            for (auto &page: this->pages)
+                page.dirty = false;
+            return 0;
+        }
+
+    private:
+        void mark_dirty(std::size_t begin, std::size_t end) {
+            auto it = std::lower_bound(this->dirty.begin(), this->dirty.end(), begin,
+                [](const auto &range, std::size_t off) { return range.second < off; });
+
+            // Absorb every range overlapping or touching the new one
+            auto last = it;
+            while ((last != this->dirty.end()) && (last->first <= end)) {
+                begin = std::min(begin, last->first), end = std::max(end, last->second);
+                ++last;
+            }
+
+            it = this->dirty.erase(it, last);
+            this->dirty.insert(it, {begin, end});
+        }
+
+        Page &get_page(std::size_t index) {
+            ++this->tick;
+
+            Page *lru = nullptr;
+            for (auto &page: this->pages) {
+                if (page.index == index) {
+                    page.last_use = this->tick;
+                    return page;
+                }
+                if (!page.dirty && (!lru || (page.last_use < lru->last_use)))
+                    lru = &page;
+            }
+
+            // Dirty pages can't be evicted, grow past the cache size if they are all taken
+            if (!lru || (this->pages.size() < num_pages))
+                lru = &this->pages.emplace_back();
+
+            auto offset = index * page_size;
+            lru->data.resize(page_size);
+            lru->index    = index;
+            lru->last_use = this->tick;
+            lru->size     = (offset < this->file_size) ? this->file.read(lru->data.data(), std::min(page_size, this->file_size - offset), offset) : 0;
+
+            this->ctx.reset(ctr_at(this->ctr, offset));
+            this->ctx.crypt(lru->data.data(), lru->data.data(), lru->size);
+            return *lru;
+        }
+};
+
+// Encrypts the image and writes it to the file. Each thread handles a slice of the image,
+// encrypting it in chunks into its own buffer which then gets written at the matching offset
+inline Result encrypt(fs::File &main, const std::uint8_t *src, std::size_t size,
+        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> &ctr,
+        std::size_t num_threads = par::core_count(), CryptStats *stats = nullptr) {
+    constexpr std::size_t chunk_size = 0x80000; // 512 KiB
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::atomic_uint64_t write_ns = 0, crypt_ns = 0;
+    std::atomic<Result> rc = 0;
+
+    par::for_slices(size, num_threads, chunk_size, [&](std::size_t begin, std::size_t end, std::size_t) {
+        auto ctx = aes::Ctr(key, ctr_at(ctr, begin));
+
+        std::vector<std::uint8_t> buf(std::min(chunk_size, end - begin));
+        for (auto offset = begin; (offset < end) && R_SUCCEEDED(rc.load()); offset += buf.size()) {
+            auto count = std::min(buf.size(), end - offset);
+
+            auto crypt_start = std::chrono::steady_clock::now();
+            ctx.crypt(buf.data(), src + offset, count);
+            crypt_ns += impl::elapsed_ns(crypt_start);
+
+            auto write_start = std::chrono::steady_clock::now();
+            if (auto res = main.write(buf.data(), count, offset); R_FAILED(res))
+                rc = res;
+            write_ns += impl::elapsed_ns(write_start);
+        }
+    });
+
+    if (stats)
+        *stats = { write_ns, 0, crypt_ns, 0, impl::elapsed_ns(start) };
+
+    return rc;
+}
+
+// Re-encrypts a decrypted image with fresh parameters and writes it back along with its header.
+// Nothing is visible until the final commit, so a failure leaves the save untouched
+inline Result write(fs::Filesystem &fs, const std::string &header_path, const std::string &main_path,
+        const std::uint8_t *data, std::size_t size, std::uint32_t seed) {
+    fs::File header, main;
+    if (auto rc = fs.open_file(header, header_path, FsOpenMode_Read | FsOpenMode_Write); R_FAILED(rc))
+        return rc;
+    if (auto rc = fs.open_file(main, main_path, FsOpenMode_Read | FsOpenMode_Write); R_FAILED(rc))
+        return rc;
+
+    std::array<std::uint8_t, 0x100> version_data;
+    if (auto read = header.read(version_data.data(), version_data.size()); read != version_data.size()) {
+        printf("Failed to read header version data (got %#lx bytes, expected %#lx)\n", read, version_data.size());
+        return Error_ShortRead;
+    }
+
+    auto hdr = generate_header(seed, version_data);
+
+    if (main.size() != size)
+        main.size(size);
+
+    CryptStats stats;
+    if (auto rc = encrypt(main, data, size, hdr.key, hdr.ctr, par::core_count(), &stats); R_FAILED(rc)) {
+        printf("Failed to write save: %#x\n", rc);
+        return rc;
+    }
+    stats.print("Encryption");
+
+    if (auto rc = header.write(hdr.data.data(), hdr.data.size()); R_FAILED(rc))
+        return rc;
+
+    main.close(), header.close();
+    return fs.flush();
+}
+
+// A decrypted file of the save, along with the parameters it was encrypted with
+struct SaveFile {
+    std::string path;
+    std::array<std::uint8_t, 0x10> key = {}, ctr = {};
+    Buffer data;
+
+    inline bool is_loaded() const {
+        return !this->data.empty();
+    }
+};
+
+// Every encrypted file of the save, indexed by owner and kind
+struct SaveSet {
+    constexpr static std::size_t num_villagers = 8;
+
+    enum class Kind: std::size_t {
+        Personal,
+        PhotoStudioIsland,
+        PostBox,
+        Profile,
+        Total,
+    };
+
+    constexpr static std::array<std::string_view, static_cast<std::size_t>(Kind::Total)> kind_names = {
+        "personal", "photo_studio_island", "postbox", "profile",
+    };
+
+    SaveFile main;
+    std::array<std::array<SaveFile, static_cast<std::size_t>(Kind::Total)>, num_villagers> villagers;
+
+    inline SaveFile &get(std::size_t villager, Kind kind) {
+        return this->villagers[villager][static_cast<std::size_t>(kind)];
+    }
+
+    inline const SaveFile &get(std::size_t villager, Kind kind) const {
+        return this->villagers[villager][static_cast<std::size_t>(kind)];
+    }
+};
+
+namespace impl {
+
+// Files are only picked up along with their header
+inline bool has_encrypted_file(const std::vector<FsDirectoryEntry> &entries, std::string_view name) {
+    auto is_file = [&entries](const std::string &path) {
+        return std::any_of(entries.begin(), entries.end(), [&path](const FsDirectoryEntry &entry) {
+            return (entry.type == FsDirEntryType_File) && (path == entry.name);
+        });
+    };
+    return is_file(std::string(name) + ".dat") && is_file(std::string(name) + "Header.dat");
+}
+
+} // namespace impl
+
+// Finds every encrypted file of the save, then decrypts all of them at once.
+// Keys are derived on the worker threads first, then the files are decrypted in chunks
+// so main.dat does not end up on a single thread while the others sit idle
+inline Result load_all(fs::Filesystem &fs, SaveSet &set, std::size_t num_threads = par::core_count()) {
+    constexpr std::size_t chunk_size = 0x100000; // 1 MiB
+
+    std::vector<SaveFile *> targets;
+
+    fs::Directory root;
+    if (auto rc = fs.open_directory(root, "/"); R_FAILED(rc))
+        return rc;
+
+    auto root_entries = root.list();
+    if (impl::has_encrypted_file(root_entries, "main"))
+        set.main.path = "/main", targets.push_back(&set.main);
+
+    for (std::size_t i = 0; i < SaveSet::num_villagers; ++i) {
+        auto dir_path = "/Villager" + std::to_string(i);
+        auto is_present = std::any_of(root_entries.begin(), root_entries.end(), [&dir_path](const FsDirectoryEntry &entry) {
+            return (entry.type == FsDirEntryType_Dir) && (dir_path.compare(1, std::string::npos, entry.name) == 0);
+        });
+        if (!is_present)
+            continue;
+
+        fs::Directory dir;
+        if (auto rc = fs.open_directory(dir, dir_path); R_FAILED(rc))
+            return rc;
+
+        auto entries = dir.list();
+        for (std::size_t j = 0; j < SaveSet::kind_names.size(); ++j) {
+            if (!impl::has_encrypted_file(entries, SaveSet::kind_names[j]))
+                continue;
+            auto &file = set.villagers[i][j];
+            file.path = dir_path + '/' + std::string(SaveSet::kind_names[j]);
+            targets.push_back(&file);
+        }
+    }
+
+    std::atomic<Result> rc = 0;
+    std::vector<fs::File> files(targets.size());
+
+    par::for_each(targets.size(), num_threads, [&](std::size_t i, std::size_t) {
+        auto &target = *targets[i];
+
+        fs::File header;
+        if (auto res = fs.open_file(header, target.path + "Header.dat") | fs.open_file(files[i], target.path + ".dat"); R_FAILED(res)) {
+            printf("Failed to open %s: %#x\n", target.path.c_str(), res);
+            rc = res;
+            return;
+        }
+
+        std::tie(target.key, target.ctr) = get_keys(header);
+        target.data.resize(files[i].size());
+    });
+
+    if (R_FAILED(rc))
+        return rc;
+
+    std::vector<std::pair<std::size_t, std::size_t>> chunks;
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+        for (std::size_t offset = 0; offset < targets[i]->data.size(); offset += chunk_size)
+            chunks.emplace_back(i, offset);
+    }
+
+    par::for_each(chunks.size(), num_threads, [&](std::size_t i, std::size_t) {
+        auto [idx, offset] = chunks[i];
+        auto &target = *targets[idx];
+
+        auto *dst = target.data.data() + offset;
+        auto want = std::min(chunk_size, target.data.size() - offset);
+        if (auto read = files[idx].read(dst, want, offset); read != want) {
+            printf("Short read in %s at %#lx (got %#lx bytes, expected %#lx)\n", target.path.c_str(), offset, read, want);
+            rc = Error_ShortRead;
+            return;
+        }
+
+        aes::Ctr(target.key, ctr_at(target.ctr, offset)).crypt(dst, dst, want);
+    });
+
+    return rc;
 }
 
 } // namespace sv
@@ -19,15 +19,21 @@
 
 #include <cstdint>
 #include <array>
+#include <utility>
 #include <type_traits>
 
 namespace sead {
 
+// x^n modulo the characteristic polynomial of the generator, see Random::jump
+using JumpPoly = unsigned __int128;
+
 // Taken from NHSE
 class Random {
     private:
         std::array<std::uint32_t, 4> state = {};
 
+        constexpr inline Random() = default;
+
     public:
         constexpr inline Random(std::uint32_t seed) {
             for (auto i = 0; i < 4; ++i)  {
@@ -65,6 +71,210 @@ class Random {
                 return get_u64();
             }
         }
+
+        constexpr inline bool operator ==(const Random &other) const {
+            return (this->state[0] == other.state[0]) && (this->state[1] == other.state[1])
+                && (this->state[2] == other.state[2]) && (this->state[3] == other.state[3]);
+        }
+
+        constexpr inline bool operator !=(const Random &other) const {
+            return !(*this == other);
+        }
+
+        // Advances the state as if get_u32 had been called n times
+        constexpr inline void discard(std::uint64_t n);
+
+        // Advances the state by the step count a jump polynomial was made for
+        constexpr inline void jump(JumpPoly poly);
+};
+
+namespace impl {
+
+// The generator is linear over GF(2), so its state after n steps is P(T) applied to the current one,
+// with T the transition and P = x^n mod the characteristic polynomial of T.
+// That polynomial is recovered from an output sequence with Berlekamp-Massey,
+// and stored without its x^128 term
+constexpr JumpPoly make_char_poly() {
+    constexpr std::size_t degree = 128, num_bits = 2 * degree;
+
+    std::array<bool, num_bits> seq = {};
+    auto rng = Random(1);
+    for (auto &bit: seq)
+        bit = rng.get_u32() & 1;
+
+    // Connection polynomials, with one more coefficient than the state has bits
+    std::array<bool, degree + 1> c = {}, b = {};
+    c[0] = b[0] = true;
+    std::size_t l = 0, m = 1;
+    for (std::size_t n = 0; n < num_bits; ++n) {
+        bool d = seq[n];
+        for (std::size_t i = 1; i <= l; ++i)
+            d ^= c[i] & seq[n - i];
+
+        if (!d) {
+            ++m;
+            continue;
+        }
+
+        auto t = c;
+        for (std::size_t i = 0; i + m <= degree; ++i)
+            c[i + m] ^= b[i];
+        if (2 * l <= n)
+            l = n + 1 - l, b = t, m = 1;
+        else
+            ++m;
+    }
+
+    // The characteristic polynomial is the reciprocal of the connection one
+    JumpPoly res = 0;
+    for (std::size_t i = 0; i < degree; ++i)
+        res |= static_cast<JumpPoly>(c[degree - i]) << i;
+    return (l == degree) ? res : 0;
+}
+
+constexpr inline JumpPoly char_poly = make_char_poly();
+
+static_assert(char_poly != 0, "Generator is not maximal-length");
+
+constexpr JumpPoly mul_mod(JumpPoly a, JumpPoly b) {
+    JumpPoly res = 0;
+    for (int i = 127; i >= 0; --i) {
+        auto carry = res >> 127;
+        res <<= 1;
+        if (carry)
+            res ^= char_poly;
+        if ((b >> i) & 1)
+            res ^= a;
+    }
+    return res;
+}
+
+// x^(2^k) mod the characteristic polynomial
+constexpr std::array<JumpPoly, 64> make_jump_powers() {
+    std::array<JumpPoly, 64> res = {};
+    res[0] = 2;
+    for (std::size_t k = 1; k < res.size(); ++k)
+        res[k] = mul_mod(res[k - 1], res[k - 1]);
+    return res;
+}
+
+constexpr inline std::array<JumpPoly, 64> jump_powers = make_jump_powers();
+
+} // namespace impl
+
+// Jumping costs about as much as 128 steps, so precompute the polynomial when jumping by the same amount repeatedly
+constexpr inline JumpPoly make_jump_poly(std::uint64_t n) {
+    JumpPoly res = 1;
+    for (std::size_t k = 0; k < impl::jump_powers.size(); ++k) {
+        if ((n >> k) & 1)
+            res = impl::mul_mod(res, impl::jump_powers[k]);
+    }
+    return res;
+}
+
+constexpr inline void Random::discard(std::uint64_t n) {
+    if (n <= 128) {
+        for (std::uint64_t i = 0; i < n; ++i)
+            this->get_u32();
+    } else {
+        this->jump(make_jump_poly(n));
+    }
+}
+
+constexpr inline void Random::jump(JumpPoly poly) {
+    // Horner's scheme, with the transition standing in for x
+    auto acc = Random();
+    for (int i = 127; i >= 0; --i) {
+        acc.get_u32();
+        if ((poly >> i) & 1) {
+            for (std::size_t j = 0; j < this->state.size(); ++j)
+                acc.state[j] ^= this->state[j];
+        }
+    }
+    this->state = acc.state;
+}
+
+namespace impl {
+
+constexpr bool check_discard(std::uint32_t seed, std::uint64_t n) {
+    auto naive = Random(seed), jumped = Random(seed);
+    for (std::uint64_t i = 0; i < n; ++i)
+        naive.get_u32();
+    jumped.jump(make_jump_poly(n));
+    return naive == jumped;
+}
+
+static_assert(check_discard(0x5eed, 0) && check_discard(0x5eed, 1) && check_discard(0x12345678, 129) && check_discard(0, 1000));
+
+} // namespace impl
+
+namespace impl {
+
+// Vector sizes can't depend on a template parameter, so spell out the supported widths
+template <std::size_t Lanes>
+struct U32Vector;
+
+template <>
+struct U32Vector<4>  { typedef std::uint32_t type __attribute__((vector_size(16))); };
+
+template <>
+struct U32Vector<8>  { typedef std::uint32_t type __attribute__((vector_size(32))); };
+
+template <>
+struct U32Vector<16> { typedef std::uint32_t type __attribute__((vector_size(64))); };
+
+} // namespace impl
+
+// Steps `Lanes` independent generators at once, with the states kept in structure-of-arrays form.
+// Relies on the compiler vector extensions, which lower to NEON on the Switch and SSE/AVX2 on x86.
+// Every lane produces exactly the same sequence as a Random constructed with its seed
+template <std::size_t Lanes>
+class RandomN {
+    public:
+        using Vector = typename impl::U32Vector<Lanes>::type;
+
+        constexpr static std::size_t lanes = Lanes;
+
+    private:
+        Vector state[4] = {};
+
+    public:
+        inline RandomN(const std::array<std::uint32_t, Lanes> &seeds) {
+            Vector seed;
+            for (std::size_t i = 0; i < Lanes; ++i)
+                seed[i] = seeds[i];
+            this->init(seed);
+        }
+
+        // Lane i is seeded with first + i
+        inline RandomN(std::uint32_t first) {
+            Vector seed;
+            for (std::size_t i = 0; i < Lanes; ++i)
+                seed[i] = first + i;
+            this->init(seed);
+        }
+
+        inline Vector get_u32() {
+            auto v1 = this->state[0] ^ (this->state[0] << 11);
+
+            this->state[0] = this->state[1];
+            this->state[1] = this->state[2];
+            this->state[2] = this->state[3];
+            return this->state[3] = v1 ^ (v1 >> 8) ^ this->state[3] ^ (this->state[3] >> 19);
+        }
+
+        // High and low halves, as two consecutive outputs
+        inline std::pair<Vector, Vector> get_u64() {
+            auto hi = this->get_u32();
+            return { hi, this->get_u32() };
+        }
+
+    private:
+        inline void init(const Vector &seed) {
+            auto prev = seed;
+            for (std::uint32_t i = 0; i < 4; ++i)
+                prev = this->state[i] = (0x6C078965 * (prev ^ (prev >> 30))) + i + 1;
+        }
 };
 
 } // namespace sead
@@ -0,0 +1,156 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace sr {
+
+// Shared between the searching threads and the code displaying the search
+struct Progress {
+    std::atomic_uint64_t done      = 0, total = 0;
+    std::atomic_size_t   found     = 0;
+    std::atomic_bool     cancelled = false;
+
+    inline void cancel() {
+        this->cancelled = true;
+    }
+
+    inline float fraction() const {
+        auto t = this->total.load();
+        return t ? static_cast<float>(this->done) / t : 0.0f;
+    }
+};
+
+namespace impl {
+
+// Range of blocks [head, tail) owned by a thread, packed so both ends move with a single CAS.
+// The owner takes blocks from the head, idle threads steal half of what is left from the tail
+struct alignas(64) Queue {
+    std::atomic_uint64_t range = 0;
+
+    constexpr static inline std::uint64_t pack(std::uint32_t head, std::uint32_t tail) {
+        return (static_cast<std::uint64_t>(tail) << 32) | head;
+    }
+
+    inline bool pop(std::uint32_t &block) {
+        auto cur = this->range.load();
+        while (true) {
+            std::uint32_t head = cur, tail = cur >> 32;
+            if (head >= tail)
+                return false;
+            if (this->range.compare_exchange_weak(cur, pack(head + 1, tail))) {
+                block = head;
+                return true;
+            }
+        }
+    }
+
+    inline bool steal(std::uint32_t &head, std::uint32_t &tail) {
+        auto cur = this->range.load();
+        while (true) {
+            std::uint32_t h = cur, t = cur >> 32;
+            if (h >= t)
+                return false;
+            auto mid = t - (t - h + 1) / 2;
+            if (this->range.compare_exchange_weak(cur, pack(h, mid))) {
+                head = mid, tail = t;
+                return true;
+            }
+        }
+    }
+};
+
+} // namespace impl
+
+// Tests every seed in [begin, end) and returns the matching ones in ascending order.
+// test(first) checks seeds first to first + Lanes - 1 at once, typically with a sead::RandomN<Lanes>,
+// and returns a mask with bit i set if first + i matches. It should bail out as soon as no lane can match anymore.
+// The search stops early when cancelled, or after finding max_results seeds
+template <std::size_t Lanes, typename Test>
+std::vector<std::uint32_t> search(std::uint64_t begin, std::uint64_t end, Test &&test, Progress &progress,
+        std::size_t num_threads = par::core_count(), std::size_t max_results = std::numeric_limits<std::size_t>::max()) {
+    static_assert(Lanes <= 64, "Match mask too narrow");
+
+    constexpr std::uint64_t block_size = 0x10000 / Lanes * Lanes;
+
+    end = std::max(begin, std::min(end, std::uint64_t(1) << 32));
+    auto num_blocks = static_cast<std::uint32_t>((end - begin + block_size - 1) / block_size);
+
+    progress.done = 0, progress.total = end - begin, progress.found = 0;
+
+    num_threads = std::clamp(num_threads, 1ul, std::max(static_cast<std::size_t>(num_blocks), 1ul));
+    std::vector<impl::Queue> queues(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i)
+        queues[i].range = impl::Queue::pack(num_blocks * i / num_threads, num_blocks * (i + 1) / num_threads);
+
+    std::mutex mtx;
+    std::vector<std::uint32_t> results;
+    std::atomic_bool is_full = false;
+
+    auto run_block = [&](std::uint32_t block) {
+        auto first = begin + block * block_size, last = std::min(first + block_size, end);
+        for (auto seed = first; seed < last; seed += Lanes) {
+            std::uint64_t mask = test(static_cast<std::uint32_t>(seed));
+            if (last - seed < Lanes)
+                mask &= (std::uint64_t(1) << (last - seed)) - 1;
+            if (!mask)
+                continue;
+
+            std::lock_guard lk(mtx);
+            for (; mask && (results.size() < max_results); mask &= mask - 1)
+                results.push_back(static_cast<std::uint32_t>(seed + __builtin_ctzll(mask)));
+            progress.found = results.size();
+            if (results.size() >= max_results)
+                is_full = true;
+        }
+        progress.done += last - first;
+    };
+
+    par::for_slices(num_threads, num_threads, 1, [&](std::size_t, std::size_t, std::size_t idx) {
+        auto &own = queues[idx];
+        while (!progress.cancelled && !is_full) {
+            std::uint32_t block;
+            if (own.pop(block)) {
+                run_block(block);
+                continue;
+            }
+
+            // Out of work, take some from the other threads
+            std::uint32_t head = 0, tail = 0;
+            bool stolen = false;
+            for (std::size_t i = 1; (i < num_threads) && !stolen; ++i)
+                stolen = queues[(idx + i) % num_threads].steal(head, tail);
+            if (!stolen)
+                break;
+            own.range = impl::Queue::pack(head, tail);
+        }
+    });
+
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+} // namespace sr
@@ -0,0 +1,57 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+// Shared between the application and tools/bg2tex, which converts the background images at build time
+namespace tx {
+
+enum class Format: std::uint32_t {
+    RGBA8,
+    BC1,
+};
+
+constexpr std::array<char, 4> texture_magic = { 'T', 'T', 'E', 'X' };
+
+// Followed by the pixel data, ready to be copied to the GPU. The header is padded so that the data
+// stays aligned when the whole file is read into a staging buffer
+struct TextureHeader {
+    std::array<char, 4> magic;
+    Format              format;
+    std::uint32_t       width, height;
+    std::uint32_t       data_size;
+    std::uint8_t        reserved[0x2c];
+};
+
+static_assert(sizeof(TextureHeader) == 0x40);
+
+constexpr std::uint32_t get_data_size(Format format, std::uint32_t width, std::uint32_t height) {
+    switch (format) {
+        case Format::RGBA8:
+            return width * height * 4;
+        case Format::BC1:
+            return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+        default:
+            return 0;
+    }
+}
+
+} // namespace tx
@@ -0,0 +1,196 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <algorithm>
+#include <numeric>
+
+#include "view.hpp"
+#include "lang.hpp"
+#include "theme.hpp"
+
+using namespace lang::literals;
+
+namespace vm {
+
+namespace {
+
+template <std::size_t N>
+void copy(std::array<char, N> &label, std::string_view str) {
+    std::snprintf(label.data(), label.size(), "%.*s", static_cast<int>(str.size()), str.data());
+}
+
+// Language strings are null-terminated, so they can be used as format strings directly
+template <std::size_t N, typename ...Args>
+void format(std::array<char, N> &label, std::string_view fmt, Args ...args) {
+    std::snprintf(label.data(), label.size(), fmt.data(), args...);
+}
+
+} // namespace
+
+Views::Views(const tp::TurnipParser &turnip_parser, const tp::VisitorParser &visitor_parser, const tp::WeatherSeedParser &seed_parser,
+        const tp::Date &save_date, std::uint64_t save_ts, bool can_check):
+    turnip_parser(turnip_parser), visitor_parser(visitor_parser), seed_parser(seed_parser), save_date(save_date), save_ts(save_ts),
+    can_check(can_check) { }
+
+void Views::set_time(std::uint64_t ts, std::uint32_t wday, std::uint32_t hour) {
+    this->wday = wday, this->hour = hour, this->day = ts / (24 * 60 * 60);
+
+    // Turnip prices change at noon, visitors leave at 5am
+    auto key = (this->day << 8) | (this->wday << 2) | ((this->hour >= 12) << 1) | (this->hour >= 5);
+    if (key != this->time_key)
+        this->time_key = key, this->dirty |= Time;
+}
+
+void Views::update() {
+    if (this->dirty & (Save | Language))
+        this->update_text();
+    if (this->dirty & (Save | Time))
+        this->update_time();
+    if (this->dirty & (Language | Check))
+        this->update_check();
+    this->dirty = 0;
+}
+
+void Views::update_text() {
+    auto &prices = this->turnip_parser.prices;
+    constexpr std::array day_keys = {
+        lang::find_key("days.sunday"),   lang::find_key("days.monday"), lang::find_key("days.tuesday"), lang::find_key("days.wednesday"),
+        lang::find_key("days.thursday"), lang::find_key("days.friday"), lang::find_key("days.saturday"),
+    };
+
+    format(this->main.title, "%s, %s " VERSION "-" COMMIT "###main", "app_name"_lang.data(), "version"_lang.data());
+    format(this->main.last_save, "last_save_time"_lang,
+        this->save_date.day, this->save_date.month, this->save_date.year, this->save_date.hour, this->save_date.minute, this->save_date.second);
+    copy(this->main.outdated, "save_outdated"_lang);
+
+    auto &t = this->turnips;
+    format(t.tab, "%s###turnips", "turnips"_lang.data());
+    format(t.header, "price_pattern"_lang, prices.buy_price, this->turnip_parser.get_pattern().data());
+
+    // The save holds the whole week, so predict the next one from this week's pattern.
+    // Computed once per save, language changes only hit the predictor's cache
+    auto pattern = (prices.pattern_type <= static_cast<std::uint32_t>(pr::Pattern::FirstWeek)) ?
+        static_cast<pr::Pattern>(prices.pattern_type) : pr::Pattern::Unknown;
+    auto &next = this->predictor.predict(pr::Observations{ 0, {}, pattern, pr::Pattern::Unknown });
+
+    t.has_next_odds = pattern != pr::Pattern::Unknown;
+    if (t.has_next_odds) {
+        copy(t.next_week, "next_week_odds"_lang);
+        for (std::uint32_t i = 0; i < next.pattern_odds.size(); ++i)
+            format(t.next_odds[i], "%s %.0f%%", tp::TurnipParser::get_pattern_name(i).data(), next.pattern_odds[i] * 100.0f);
+    }
+
+    copy(t.next_prices, "next_week_prices"_lang);
+    for (std::size_t i = 0; i < next.bands.size(); ++i) {
+        auto &band = next.bands[i];
+        std::array<char, 0x20> min, max; // Both fit in a label with the separator
+        format(t.next_bands[i], "%u-%u (%u)", band.low, band.high, band.median);
+        format(min, "turnips_min"_lang, band.min), format(max, "turnips_max"_lang, band.max);
+        format(t.next_bounds[i], "%s, %s", min.data(), max.data());
+    }
+
+    copy(t.am, "am"_lang), copy(t.pm, "pm"_lang);
+    for (std::size_t i = 0; i < day_keys.size(); ++i)
+        copy(t.days[i], lang::get_string(day_keys[i]));
+    for (std::size_t i = 0; i < prices.week_prices.size(); ++i)
+        format(t.prices[i], "%d", prices.week_prices[i]);
+
+    auto [min, max] = std::minmax_element(prices.week_prices.begin() + 2, prices.week_prices.end());
+    float average = static_cast<float>(std::accumulate(prices.week_prices.begin() + 2,
+        prices.week_prices.end(), 0)) / (prices.week_prices.size() - 2);
+    format(t.max, "turnips_max"_lang, *max);
+    format(t.min, "turnips_min"_lang, *min);
+    format(t.average, "turnips_average"_lang, average);
+    copy(t.graph, "week_graph"_lang);
+    std::transform(prices.week_prices.begin() + 2, prices.week_prices.end(), t.plot.begin(),
+        [](std::uint32_t price) { return static_cast<float>(price); });
+
+    auto &v = this->visitors;
+    format(v.tab, "%s###visitors", "visitors"_lang.data());
+    v.days = t.days;
+    auto names = this->visitor_parser.get_visitor_names();
+    for (std::size_t i = 0; i < names.size(); ++i)
+        copy(v.names[i], names[i]);
+    copy(v.celeste, "npcs.celeste"_lang);
+    copy(v.wisp,    "npcs.wisp"_lang);
+    v.celeste_day = this->visitor_parser.get_celeste_day(), v.wisp_day = this->visitor_parser.get_wisp_day();
+
+    auto &w = this->weather;
+    auto seed = this->seed_parser.calculate_weather_seed();
+    format(w.tab, "%s###weather", "weather"_lang.data());
+    format(w.hemisphere, "hemisphere"_lang, this->seed_parser.get_hemisphere_name().data());
+    format(w.seed, "weather_seed"_lang, seed, seed);
+    copy(w.tip, "weather_url_tip"_lang);
+
+    format(this->language.tab, "%s###lang", "language"_lang.data());
+}
+
+void Views::update_time() {
+    auto &prices = this->turnip_parser.prices;
+
+    this->main.is_outdated = (this->day > this->save_ts / (24 * 60 * 60) + this->wday)
+        && ((this->wday != 0) || (this->hour >= 5));
+
+    auto &t = this->turnips;
+    auto [min, max] = std::minmax_element(prices.week_prices.begin() + 2, prices.week_prices.end());
+    auto cur = 2 * this->wday + (this->hour >= 12);
+    for (std::size_t i = 0; i < prices.week_prices.size(); ++i) {
+        if (i == cur)
+            t.colors[i] = th::text_cur_col;
+        else if (prices.week_prices[i] == *max)
+            t.colors[i] = th::text_max_col;
+        else if (prices.week_prices[i] == *min)
+            t.colors[i] = th::text_min_col;
+        else
+            t.colors[i] = th::text_def_col;
+    }
+    t.max_color = th::text_max_col, t.min_color = th::text_min_col;
+
+    // Visitors leave at 5am, so adjust the weekday
+    auto &v = this->visitors;
+    auto visitor_day = (this->hour >= 5) ? this->wday : std::clamp(this->wday - 1, 0u, 7u);
+    for (std::uint32_t i = 0; i < v.colors.size(); ++i)
+        v.colors[i] = (i == visitor_day) ? th::text_cur_col : th::text_def_col;
+}
+
+void Views::update_check() {
+    auto &m = this->main;
+    m.can_check = this->can_check && (this->check_state != CheckState::Running);
+    format(m.check, "%s###check", "save_check"_lang.data());
+
+    switch (this->check_state) {
+        case CheckState::Idle:
+            m.check_status[0] = '\0';
+            break;
+        case CheckState::Running:
+            copy(m.check_status, "save_check_running"_lang);
+            break;
+        case CheckState::Ok:
+            format(m.check_status, "save_check_ok"_lang, this->num_regions);
+            break;
+        case CheckState::Corrupt:
+            format(m.check_status, "save_check_corrupt"_lang, this->num_corrupt, this->num_regions);
+            break;
+        case CheckState::Unknown:
+            copy(m.check_status, "save_check_unknown"_lang);
+            break;
+    }
+}
+
+} // namespace vm
@@ -0,0 +1,142 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+#include "parser.hpp"
+#include "predict.hpp"
+
+namespace vm {
+
+using Label      = std::array<char, 0x80>;
+using ShortLabel = std::array<char, 0x10>;
+
+// Display data of each part of the GUI, ready to be handed to ImGui as-is
+
+enum class CheckState {
+    Idle,
+    Running,
+    Ok,
+    Corrupt,
+    Unknown,
+};
+
+struct MainView {
+    Label title, last_save, outdated, check, check_status;
+    bool  is_outdated;
+    bool  can_check;
+};
+
+struct TurnipView {
+    Label                                   tab, header, next_week, next_prices, am, pm, max, min, average, graph;
+    bool                                    has_next_odds;
+    std::array<Label, pr::num_patterns>     next_odds;
+    std::array<ShortLabel, 12>              next_bands;  // 10th-90th percentile and median of next week's prices
+    std::array<Label, 12>                   next_bounds; // Their exact min and max
+    std::array<Label, 7>                    days;
+    std::array<ShortLabel, 14>              prices;
+    std::array<std::uint32_t, 14>           colors;
+    std::uint32_t                           max_color, min_color;
+    std::array<float, 12>                   plot;
+};
+
+struct VisitorView {
+    Label                           tab, celeste, wisp;
+    std::array<Label, 7>            days, names;
+    std::array<std::uint32_t, 7>    colors;
+    std::uint32_t                   celeste_day, wisp_day;
+};
+
+struct WeatherView {
+    Label tab, hemisphere, seed, tip;
+};
+
+struct LanguageView {
+    Label tab;
+};
+
+// Builds the views from the save and keeps them until something they depend on changes.
+// Text is rebuilt when the save or the language change, colors when the current half-day does
+class Views {
+    public:
+        enum Dependency: std::uint32_t {
+            Save     = 1 << 0,
+            Language = 1 << 1,
+            Time     = 1 << 2,
+            Check    = 1 << 3,
+            All      = Save | Language | Time | Check,
+        };
+
+    private:
+        tp::TurnipParser      turnip_parser;
+        tp::VisitorParser     visitor_parser;
+        tp::WeatherSeedParser seed_parser;
+        pr::Predictor         predictor;
+        tp::Date              save_date = {};
+        std::uint64_t         save_ts   = 0;
+
+        std::uint32_t dirty    = All;
+        std::uint64_t time_key = UINT64_MAX;
+        std::uint32_t wday = 0, hour = 0;
+        std::uint64_t day  = 0;
+
+        bool          can_check   = false;
+        CheckState    check_state = CheckState::Idle;
+        std::size_t   num_corrupt = 0, num_regions = 0;
+
+        MainView     main     = {};
+        TurnipView   turnips  = {};
+        VisitorView  visitors = {};
+        WeatherView  weather  = {};
+        LanguageView language = {};
+
+    public:
+        Views(const tp::TurnipParser &turnip_parser, const tp::VisitorParser &visitor_parser, const tp::WeatherSeedParser &seed_parser,
+            const tp::Date &save_date, std::uint64_t save_ts, bool can_check);
+
+        inline void invalidate(std::uint32_t deps) {
+            this->dirty |= deps;
+        }
+
+        // Only invalidates the views when the half-day or the visitor day changed
+        void set_time(std::uint64_t ts, std::uint32_t wday, std::uint32_t hour);
+
+        inline void set_check(CheckState state, std::size_t num_corrupt = 0, std::size_t num_regions = 0) {
+            this->check_state = state, this->num_corrupt = num_corrupt, this->num_regions = num_regions;
+            this->dirty |= Check;
+        }
+
+        // Rebuilds whatever was invalidated
+        void update();
+
+        inline const MainView     &get_main()     const { return this->main;     }
+        inline const TurnipView   &get_turnips()  const { return this->turnips;  }
+        inline const VisitorView  &get_visitors() const { return this->visitors; }
+        inline const WeatherView  &get_weather()  const { return this->weather;  }
+        inline const LanguageView &get_language() const { return this->language; }
+
+    private:
+        void update_text();
+        void update_time();
+        void update_check();
+};
+
+} // namespace vm
@@ -0,0 +1,104 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Steady-state frames make no heap allocation: the frame contents are built headless with ImGui, without a renderer,
+// from views of a fixed save. Rebuilding the text for a language change or a new half-day must not allocate either
+
+#include <cstdint>
+#include <cstdio>
+#include <imgui.h>
+
+#include "alloc.hpp"
+#include "gui.hpp"
+#include "lang.hpp"
+#include "view.hpp"
+#include "test.hpp"
+
+namespace {
+
+struct Frame {
+    std::uint64_t ts;
+    std::uint32_t wday, hour;
+};
+
+gui::Actions run_frame(vm::Views &views, const Frame &frame) {
+    auto &io = ImGui::GetIO();
+    io.DeltaTime = 1.0f / 60.0f;
+    ImGui::NewFrame();
+
+    views.set_time(frame.ts, frame.wday, frame.hour);
+    views.update();
+    auto actions = gui::draw_main_window(views);
+
+    ImGui::Render();
+    return actions;
+}
+
+} // namespace
+
+int main() {
+    constexpr std::size_t warmup_frames = 8, num_frames = 240;
+
+    ImGui::SetAllocatorFunctions(al::imgui_alloc, al::imgui_free);
+    ImGui::CreateContext();
+
+    auto &io = ImGui::GetIO();
+    io.DisplaySize = { 1280.0f, 720.0f };
+    io.IniFilename = nullptr;
+    io.Fonts->AddFontDefault();
+    unsigned char *pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+
+    // No language table on the host, strings fall back to their key
+    lang::initialize_to_system_language();
+
+    tp::TurnipPrices prices = {};
+    prices.buy_price = 97, prices.pattern_type = 1;
+    for (std::size_t i = 2; i < prices.week_prices.size(); ++i)
+        prices.week_prices[i] = 60 + 37 * i % 500;
+    tp::VisitorSchedule schedule = {};
+    schedule.npcs = { 0, 1, 2, 3, 4, 5, 6 }, schedule.wisp_day = 2, schedule.celeste_day = 4;
+
+    auto views = vm::Views(tp::TurnipParser(tp::Version::V160, prices), tp::VisitorParser(tp::Version::V160, schedule),
+        tp::WeatherSeedParser(tp::Version::V160, tp::WeatherInfo{ 0, 0x12345678 }), tp::Date{ 2020, 5, 12, 10, 30, 0 }, 1589279400, true);
+
+    // Tuesday morning, then the afternoon
+    auto morning = Frame{ 1589366400, 2, 10 }, afternoon = Frame{ 1589366400 + 4 * 60 * 60, 2, 14 };
+
+    // The first frames create the window and tab state
+    for (std::size_t i = 0; i < warmup_frames; ++i)
+        run_frame(views, morning);
+
+    auto counter = al::FrameCounter();
+    for (std::size_t i = 0; i < num_frames; ++i) {
+        if (i == num_frames / 3)
+            views.invalidate(vm::Views::Language);
+        if (i == num_frames / 2)
+            views.set_check(vm::CheckState::Corrupt, 2, 19);
+
+        counter.begin();
+        run_frame(views, (i < 2 * num_frames / 3) ? morning : afternoon);
+        auto stats = counter.end();
+        if (stats.total())
+            std::printf("frame %zu: %zu allocations (%zu from ImGui), %zu bytes\n", i, stats.total(), stats.imgui_allocs, stats.bytes);
+        CHECK(stats.total() == 0);
+    }
+
+    ImGui::DestroyContext();
+    return test::report("frame_alloc");
+}
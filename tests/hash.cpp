@@ -0,0 +1,100 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// hs::check_main: revisions without a table have their layout found in the save or taken from an earlier intact one,
+// and a corrupt save is reported
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "hash.hpp"
+#include "sead.hpp"
+#include "test.hpp"
+
+namespace {
+
+// Random contents with valid hashes
+std::vector<std::uint8_t> make_save(const hs::Layout &layout, std::uint32_t seed) {
+    auto rng = sead::Random(seed);
+    std::vector<std::uint8_t> data(layout.file_size);
+    for (auto &b: data)
+        b = rng.get_u32() >> 24;
+    for (auto &region: layout) {
+        auto hash = hs::murmur3(data.data() + region.begin(), region.size);
+        std::memcpy(data.data() + region.hash_offset, &hash, sizeof(hash));
+    }
+    return data;
+}
+
+} // namespace
+
+int main() {
+    auto v100   = static_cast<tp::Version>(0);
+    auto latest = static_cast<tp::Version>(hs::impl::main_shapes.size() - 1);
+
+    // Scaled down so the test stays quick, discovery only relies on the structure
+    auto layout = hs::make_main_layout({ { 0x1d6c, 0x3384 }, { 0x5ac4, 0x607c }, 0x84d4 });
+    auto save   = make_save(layout, 1);
+
+    auto found = hs::find_main_layout(save.data(), save.size());
+    CHECK((found.count == layout.count) && (found.file_size == layout.file_size));
+    CHECK(std::equal(found.begin(), found.end(), layout.begin()));
+
+    auto report = hs::check_main(latest, save.data(), save.size());
+    CHECK(report.known_layout && (report.num_regions == layout.count) && report.corrupt.empty());
+
+    // The table of 1.0.0 doesn't fit this file, which is searched instead
+    CHECK(hs::get_main_layout(v100).file_size != save.size());
+    CHECK(hs::check_main(v100, save.data(), save.size()).shape == report.shape);
+
+    // Corruption past the scanned regions is located
+    auto shape = report.shape;
+    save[layout.regions[5].begin() + 0x10] ^= 1, save[layout.regions[18].begin()] ^= 1;
+    report = hs::check_main(latest, save.data(), save.size());
+    CHECK(report.known_layout && (report.shape == shape) && (report.corrupt.size() == 2));
+    CHECK((report.corrupt[0] == layout.regions[5]) && (report.corrupt[1] == layout.regions[18]));
+
+    // When all but the scanned regions are corrupt, the layout can't be confirmed
+    auto wrecked = save;
+    for (std::size_t i = 4; i < layout.count; ++i)
+        wrecked[layout.regions[i].end() - 1] ^= 1;
+    CHECK(!hs::find_main_layout(wrecked.data(), wrecked.size()).is_known());
+
+    // Nor can it be found once a scanned region is corrupt, unless the shape of an intact save was kept
+    save[layout.regions[1].begin()] ^= 1;
+    CHECK(!hs::check_main(latest, save.data(), save.size()).known_layout);
+    report = hs::check_main(latest, save.data(), save.size(), shape);
+    CHECK(report.known_layout && (report.corrupt.size() == 3) && (report.corrupt[0] == layout.regions[1]));
+
+    // A kept shape that doesn't fit the file is ignored
+    auto other = hs::make_main_layout({ { 0x1d6c, 0x3384 }, { 0x5ac4, 0x607c }, 0x84d8 });
+    auto grown = make_save(other, 3);
+    report = hs::check_main(latest, grown.data(), grown.size(), shape);
+    CHECK(report.known_layout && report.corrupt.empty() && (report.num_regions == other.count));
+
+    // Known revisions still locate the corrupt regions
+    auto table = hs::get_main_layout(v100);
+    auto full  = make_save(table, 2);
+    full[table.regions[3].begin()] ^= 1, full[table.regions[18].end() - 1] ^= 1;
+    report = hs::check_main(v100, full.data(), full.size());
+    CHECK(report.known_layout && (report.corrupt.size() == 2));
+    CHECK((report.corrupt[0] == table.regions[3]) && (report.corrupt[1] == table.regions[18]));
+
+    return test::report("hash");
+}
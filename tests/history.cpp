@@ -0,0 +1,127 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// hist::History: appends never touch recorded bytes, older snapshots are skipped, and piled up blocks are compacted
+
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "history.hpp"
+#include "test.hpp"
+
+namespace {
+
+hist::Snapshot make_snapshot(std::uint64_t ts) {
+    hist::Snapshot s;
+    s.timestamp = ts;
+    s.prices.buy_price = 90 + ts % 20;
+    for (std::size_t i = 0; i < s.prices.week_prices.size(); ++i)
+        s.prices.week_prices[i] = 50 + (ts * 7 + i * 13) % 500;
+    s.prices.pattern_type = ts % 4;
+    for (std::size_t i = 0; i < s.npcs.size(); ++i)
+        s.npcs[i] = (ts + i) % 11;
+    s.weather_seed = static_cast<std::uint32_t>(ts * 2654435761u);
+    return s;
+}
+
+bool same(const hist::Snapshot &lhs, const hist::Snapshot &rhs) {
+    return (lhs.timestamp == rhs.timestamp) && (lhs.prices.buy_price == rhs.prices.buy_price)
+        && (lhs.prices.week_prices == rhs.prices.week_prices) && (lhs.prices.pattern_type == rhs.prices.pattern_type)
+        && (lhs.npcs == rhs.npcs) && (lhs.weather_seed == rhs.weather_seed);
+}
+
+std::vector<std::uint8_t> contents(fs::Filesystem &fs, const std::string &path) {
+    fs::File file;
+    if (R_FAILED(fs.open_file(file, path)))
+        return {};
+    std::vector<std::uint8_t> res(file.size());
+    res.resize(file.read(res.data(), res.size()));
+    return res;
+}
+
+} // namespace
+
+int main() {
+    auto dir  = test::make_temp_dir();
+    auto fs   = fs::Filesystem(dir);
+    auto path = std::string("/Turnips/history.bin");
+
+    constexpr std::uint64_t week = 7 * 24 * 60 * 60;
+    {
+        hist::History history;
+        CHECK(R_SUCCEEDED(history.open(fs, path)));
+        for (std::uint64_t i = 1; i <= 3; ++i)
+            CHECK(R_SUCCEEDED(history.append(make_snapshot(i * week))));
+
+        // Recorded bytes are left untouched by later appends
+        auto before = contents(fs, path);
+        CHECK(R_SUCCEEDED(history.append(make_snapshot(4 * week))));
+        auto after = contents(fs, path);
+        CHECK((after.size() > before.size()) && std::equal(before.begin(), before.end(), after.begin()));
+
+        // The same timestamp again, and one from an older save, are skipped without error
+        CHECK(R_SUCCEEDED(history.append(make_snapshot(4 * week))));
+        CHECK(R_SUCCEEDED(history.append(make_snapshot(2 * week + 1))));
+        CHECK(history.size() == 4);
+        CHECK(contents(fs, path) == after);
+    }
+
+    // Enough single appends to trigger compaction on the next open
+    constexpr std::uint64_t count = 200;
+    {
+        hist::History history;
+        CHECK(R_SUCCEEDED(history.open(fs, path)));
+        CHECK(history.size() == 4);
+        for (std::uint64_t i = 5; i <= count; ++i)
+            CHECK(R_SUCCEEDED(history.append(make_snapshot(i * week))));
+        CHECK(history.num_blocks() == count);
+    }
+
+    {
+        hist::History history;
+        CHECK(R_SUCCEEDED(history.open(fs, path)));
+        CHECK(history.num_blocks() == (count + hist::History::block_capacity - 1) / hist::History::block_capacity);
+        CHECK(!fs.is_file(path + ".tmp"));
+
+        auto all = history.query(0, UINT64_MAX);
+        CHECK(all.size() == count);
+        for (std::uint64_t i = 0; i < std::min<std::uint64_t>(all.size(), count); ++i)
+            CHECK(same(all[i], make_snapshot((i + 1) * week)));
+
+        hist::Snapshot found;
+        CHECK(history.find(100 * week + 3, found) && same(found, make_snapshot(100 * week)));
+        CHECK(!history.find(week - 1, found));
+
+        // Appends go on after the compacted blocks
+        CHECK(R_SUCCEEDED(history.append(make_snapshot((count + 1) * week))));
+        CHECK(history.size() == count + 1);
+    }
+
+    // A compaction interrupted after the old file was deleted is finished on open
+    CHECK(R_SUCCEEDED(fs.move_file(path, path + ".tmp")));
+    {
+        hist::History history;
+        CHECK(R_SUCCEEDED(history.open(fs, path)));
+        CHECK(history.size() == count + 1);
+        CHECK(!fs.is_file(path + ".tmp"));
+    }
+
+    test::remove_dir(dir);
+    return test::report("history");
+}
@@ -0,0 +1,138 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// pr::Predictor against weeks replayed from random seeds with the game's generator: every hidden price falls within
+// the predicted bounds, and the 10th-90th percentile bands hold about 80% of them.
+// pr::SeedSearch recovers a planted seed from its week, also when resumed from a checkpoint
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "predict.hpp"
+#include "test.hpp"
+
+namespace {
+
+void test_accuracy() {
+    constexpr std::size_t num_weeks = 3000;
+
+    auto rng = sead::Random(0x5eed);
+    std::size_t num_hidden = 0, num_in_band = 0;
+    std::chrono::nanoseconds elapsed = {};
+
+    for (std::size_t i = 0; i < num_weeks; ++i) {
+        auto previous = static_cast<pr::Pattern>(rng.get_u32() % pr::num_patterns);
+        pr::Week week;
+        CHECK(pr::replay(rng.get_u32(), previous, pr::Observations{}, &week));
+
+        // The prices of the first few half-days are known, and the buy price and last pattern most of the time
+        pr::Observations obs;
+        auto num_known = rng.get_u32() % pr::num_half_days;
+        obs.buy_price  = (i % 10) ? week.base_price : 0;
+        obs.previous   = (i % 4)  ? previous : pr::Pattern::Unknown;
+        std::copy_n(week.prices.begin(), num_known, obs.prices.begin());
+
+        auto start = std::chrono::steady_clock::now();
+        auto prediction = pr::Predictor::compute(obs);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        CHECK(prediction.is_consistent);
+        for (std::size_t day = num_known; day < pr::num_half_days; ++day) {
+            auto &band = prediction.bands[day];
+            auto price = week.prices[day];
+            CHECK((price >= band.min) && (price <= band.max));
+            num_hidden  += 1;
+            num_in_band += (price >= band.low) && (price <= band.high);
+        }
+    }
+
+    auto coverage = static_cast<double>(num_in_band) / num_hidden;
+    std::printf("predict: %.1f%% of %zu hidden prices within the 10-90 band, %.2fms per prediction\n",
+        100.0 * coverage, num_hidden, std::chrono::duration<double, std::milli>(elapsed).count() / num_weeks);
+    CHECK((coverage > 0.75) && (coverage < 0.9));
+}
+
+pr::Observations observe(const pr::Week &week, pr::Pattern previous) {
+    return pr::Observations{ week.base_price, week.prices, previous, week.pattern };
+}
+
+// The week after moving in is always Decreasing, whatever the pattern roll gives
+void test_first_week() {
+    std::size_t num_only_first = 0;
+    for (std::uint32_t seed = 1; seed < 200; ++seed) {
+        pr::Week week;
+        CHECK(pr::replay(seed, pr::Pattern::FirstWeek, pr::Observations{}, &week));
+        CHECK(week.pattern == pr::Pattern::Decreasing);
+
+        auto obs = observe(week, pr::Pattern::Unknown);
+        CHECK(pr::replay_any(seed, obs));
+
+        // Most rolls lead elsewhere from any other pattern, only the first week explains these weeks
+        bool other = false;
+        for (std::size_t i = 0; i < pr::num_patterns; ++i)
+            other |= pr::replay(seed, static_cast<pr::Pattern>(i), obs);
+        num_only_first += !other;
+    }
+    CHECK(num_only_first > 100);
+
+    auto next = pr::get_next_odds(pr::Pattern::FirstWeek);
+    CHECK(next[static_cast<std::size_t>(pr::Pattern::Decreasing)] == 1.0f);
+}
+
+// The seed is planted in the second segment, which is only searched after resuming from the checkpoint of the first
+void test_seed_search() {
+    constexpr std::uint32_t seed = pr::SeedSearch::segment_size + 0x1234567;
+
+    pr::Week week;
+    CHECK(pr::replay(seed, pr::Pattern::SmallSpike, pr::Observations{}, &week));
+    auto obs = observe(week, pr::Pattern::SmallSpike);
+
+    std::vector<std::uint8_t> checkpoint;
+    {
+        auto search   = pr::SeedSearch(obs);
+        auto progress = sr::Progress();
+        CHECK(search.step(progress));
+        CHECK(std::find(search.get_seeds().begin(), search.get_seeds().end(), seed) == search.get_seeds().end());
+        checkpoint = search.save_checkpoint();
+    }
+
+    // A checkpoint only resumes a search on the same observations
+    auto other = obs;
+    other.prices[3] += 1;
+    CHECK(!pr::SeedSearch(other).load_checkpoint(checkpoint));
+
+    auto search = pr::SeedSearch(obs);
+    CHECK(search.load_checkpoint(checkpoint));
+    auto progress = sr::Progress();
+    CHECK(search.step(progress));
+    CHECK(!search.is_done());
+    CHECK(std::find(search.get_seeds().begin(), search.get_seeds().end(), seed) != search.get_seeds().end());
+    for (auto found: search.get_seeds())
+        CHECK(pr::replay(found, obs.previous, obs));
+}
+
+} // namespace
+
+int main() {
+    test_accuracy();
+    test_first_week();
+    test_seed_search();
+    return test::report("predict");
+}
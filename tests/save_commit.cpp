@@ -0,0 +1,100 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// sv::SaveImage commits: only the blocks covering modified bytes and the hashes of their regions are rewritten,
+// and the file decrypts to the edited image
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "save.hpp"
+#include "test.hpp"
+
+int main() {
+    auto dir = test::make_temp_dir();
+    auto fs  = fs::Filesystem(dir);
+
+    auto rng = sead::Random(8);
+    std::vector<std::uint8_t> image(0x48000);
+    for (auto &b: image)
+        b = rng.get_u32() >> 24;
+
+    auto hdr = sv::generate_header(0x88, {});
+    std::vector<std::uint8_t> ciphertext(image.size());
+    aes::Ctr(hdr.key, hdr.ctr).crypt(ciphertext.data(), image.data(), image.size());
+    {
+        fs::File file;
+        CHECK(R_SUCCEEDED(fs.create_file("/main.dat", ciphertext.size())));
+        CHECK(R_SUCCEEDED(fs.open_file(file, "/main.dat", FsOpenMode_Write)));
+        CHECK(R_SUCCEEDED(file.write(ciphertext.data(), ciphertext.size())));
+    }
+
+    fs::File main;
+    CHECK(R_SUCCEEDED(fs.open_file(main, "/main.dat", FsOpenMode_Read | FsOpenMode_Write)));
+
+    // The edit at 0x20005 is outside of every region, and the second region is never modified
+    hs::Layout layout = { image.size(), 3, { hs::Region{ 0x8000, 0x10000 }, hs::Region{ 0x30000, 0x1000 }, hs::Region{ 0x40000, 0x7ffc } } };
+
+    auto save = sv::SaveImage(main, hdr.key, hdr.ctr);
+    CHECK(R_SUCCEEDED(save.commit(fs, layout)));
+
+    // Edits straddling a page boundary, touching ranges merged into one, and one in the last partial page
+    auto edit = [&](std::size_t offset, std::vector<std::uint8_t> bytes) {
+        CHECK(save.write(bytes.data(), bytes.size(), offset) == bytes.size());
+        std::copy(bytes.begin(), bytes.end(), image.begin() + offset);
+    };
+    edit(0xfffe, { 1, 2, 3, 4 });
+    edit(0x20005, { 5, 6, 7 });
+    edit(0x20008, { 8 });
+    edit(0x47ff0, std::vector<std::uint8_t>(0x10, 9));
+    CHECK(save.dirty_ranges().size() == 3);
+
+    // Hashes can't be placed without the layout
+    CHECK(save.commit(fs, hs::Layout{}) == sv::Error_UnknownLayout);
+    CHECK(save.dirty_ranges().size() == 3);
+
+    CHECK(R_SUCCEEDED(save.commit(fs, layout)));
+    CHECK(save.dirty_ranges().empty());
+
+    for (auto &region: { layout.regions[0], layout.regions[2] }) {
+        auto hash = hs::murmur3(image.data() + region.begin(), region.size);
+        std::copy_n(reinterpret_cast<const std::uint8_t *>(&hash), sizeof(hash), image.begin() + region.hash_offset);
+    }
+
+    std::vector<std::uint8_t> committed(ciphertext.size());
+    CHECK(main.read(committed.data(), committed.size()) == committed.size());
+
+    // Blocks outside of the edits keep their ciphertext
+    for (std::size_t i = 0; i < committed.size(); i += 0x10) {
+        auto touched = ((i >= 0xfff0) && (i < 0x10010)) || (i == 0x20000) || (i == 0x47ff0) || (i == 0x8000) || (i == 0x40000);
+        CHECK(touched || std::equal(&committed[i], &committed[i] + 0x10, &ciphertext[i]));
+    }
+
+    auto plain = sv::decrypt(main, main.size(), hdr.key, hdr.ctr);
+    CHECK((plain.size() == image.size()) && std::equal(plain.begin(), plain.end(), image.begin()));
+
+    auto corrupt = hs::verify(layout, plain.data(), plain.size());
+    CHECK((corrupt.size() == 1) && (corrupt[0] == layout.regions[1]));
+
+    // The image reads back the edits from its pages, and the committed file from a fresh one
+    auto reopened = sv::SaveImage(main, hdr.key, hdr.ctr);
+    CHECK(reopened.read<std::uint32_t>(0xfffe) == save.read<std::uint32_t>(0xfffe));
+
+    test::remove_dir(dir);
+    return test::report("save_commit");
+}
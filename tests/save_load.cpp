@@ -0,0 +1,121 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Smoke test of sv::load_all over a small save fixture: every file with a header is found and decrypted,
+// the others are left alone
+
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "save.hpp"
+#include "test.hpp"
+
+namespace {
+
+std::vector<std::uint8_t> make_image(std::size_t size, std::uint32_t seed) {
+    auto rng = sead::Random(seed);
+    std::vector<std::uint8_t> res(size);
+    for (auto &b: res)
+        b = rng.get_u32() >> 24;
+    return res;
+}
+
+void create(fs::Filesystem &fs, const std::string &path, const void *data, std::size_t size) {
+    fs::File file;
+    CHECK(R_SUCCEEDED(fs.create_file(path, size)));
+    CHECK(R_SUCCEEDED(fs.open_file(file, path, FsOpenMode_Write)));
+    CHECK(R_SUCCEEDED(file.write(data, size)));
+}
+
+// Encrypts the image like the game does, with parameters from a fresh header
+void create_encrypted(fs::Filesystem &fs, const std::string &path, const std::vector<std::uint8_t> &image, std::uint32_t seed) {
+    auto hdr = sv::generate_header(seed, {});
+    create(fs, path + "Header.dat", hdr.data.data(), hdr.data.size());
+
+    std::vector<std::uint8_t> ciphertext(image.size());
+    aes::Ctr(hdr.key, hdr.ctr).crypt(ciphertext.data(), image.data(), image.size());
+    create(fs, path + ".dat", ciphertext.data(), ciphertext.size());
+}
+
+struct Expected {
+    const sv::SaveFile       *file;
+    std::string               path;
+    std::vector<std::uint8_t> image;
+};
+
+} // namespace
+
+int main() {
+    auto dir = test::make_temp_dir();
+    auto fs  = fs::Filesystem(dir);
+
+    CHECK(R_SUCCEEDED(fs.create_directory("/Villager0")));
+    CHECK(R_SUCCEEDED(fs.create_directory("/Villager3")));
+    CHECK(R_SUCCEEDED(fs.create_directory("/Landname")));
+
+    // main.dat spans several load chunks, with a partial last one
+    auto main_image      = make_image(0x2c0010, 1);
+    auto personal0_image = make_image(0x36a0, 2);
+    auto profile0_image  = make_image(0x10, 3);
+    auto personal3_image = make_image(0x100000, 4);
+
+    create_encrypted(fs, "/main",               main_image,      0x11);
+    create_encrypted(fs, "/Villager0/personal", personal0_image, 0x22);
+    create_encrypted(fs, "/Villager0/profile",  profile0_image,  0x33);
+    create_encrypted(fs, "/Villager3/personal", personal3_image, 0x44);
+
+    // Files without a header, or outside of the known locations, are skipped
+    create(fs, "/Villager0/postbox.dat", main_image.data(), 0x100);
+    create(fs, "/Villager3/photo_studio_islandHeader.dat", main_image.data(), sv::header_size);
+    create_encrypted(fs, "/Landname/personal", profile0_image, 0x55);
+
+    for (std::size_t num_threads: { 1ul, 3ul, 8ul }) {
+        sv::SaveSet set;
+        CHECK(R_SUCCEEDED(sv::load_all(fs, set, num_threads)));
+
+        using Kind = sv::SaveSet::Kind;
+        auto expected = std::vector<Expected>{
+            { &set.main,                          "/main",               main_image      },
+            { &set.get(0, Kind::Personal),        "/Villager0/personal", personal0_image },
+            { &set.get(0, Kind::Profile),         "/Villager0/profile",  profile0_image  },
+            { &set.get(3, Kind::Personal),        "/Villager3/personal", personal3_image },
+        };
+
+        for (auto &[file, path, image]: expected) {
+            CHECK(file->is_loaded());
+            CHECK(file->path == path);
+            CHECK((file->data.size() == image.size()) && std::equal(image.begin(), image.end(), file->data.begin()));
+        }
+
+        std::size_t num_loaded = set.main.is_loaded();
+        for (auto &villager: set.villagers)
+            num_loaded += std::count_if(villager.begin(), villager.end(), [](const sv::SaveFile &file) { return file.is_loaded(); });
+        CHECK(num_loaded == expected.size());
+    }
+
+    // A save without main.dat still loads the villager files
+    CHECK(R_SUCCEEDED(fs.delete_file("/main.dat")));
+    sv::SaveSet set;
+    CHECK(R_SUCCEEDED(sv::load_all(fs, set)));
+    CHECK(!set.main.is_loaded() && set.get(3, sv::SaveSet::Kind::Personal).is_loaded());
+
+    test::remove_dir(dir);
+    return test::report("save_load");
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Round trip of sv::write: the re-encrypted save must decrypt back to the image with the keys derived from its new header
+
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "save.hpp"
+#include "test.hpp"
+
+namespace {
+
+std::vector<std::uint8_t> make_image(std::size_t size, std::uint32_t seed) {
+    auto rng = sead::Random(seed);
+    std::vector<std::uint8_t> res(size);
+    for (auto &b: res)
+        b = rng.get_u32() >> 24;
+    return res;
+}
+
+void create(fs::Filesystem &fs, const std::string &path, const void *data, std::size_t size) {
+    fs::File file;
+    CHECK(R_SUCCEEDED(fs.create_file(path, size)));
+    CHECK(R_SUCCEEDED(fs.open_file(file, path, FsOpenMode_Write)));
+    CHECK(R_SUCCEEDED(file.write(data, size)));
+}
+
+void check_round_trip(fs::Filesystem &fs, const std::vector<std::uint8_t> &image, std::uint32_t seed,
+        const std::array<std::uint8_t, 0x100> &version_data) {
+    CHECK(R_SUCCEEDED(sv::write(fs, "/mainHeader.dat", "/main.dat", image.data(), image.size(), seed)));
+
+    fs::File header, main;
+    CHECK(R_SUCCEEDED(fs.open_file(header, "/mainHeader.dat")));
+    CHECK(R_SUCCEEDED(fs.open_file(main, "/main.dat")));
+    CHECK(header.size() == sv::header_size);
+    CHECK(main.size() == image.size());
+
+    // The version data is carried over, the encryption data is the one the game would generate for this seed
+    std::array<std::uint8_t, sv::header_size> header_data;
+    CHECK(header.read(header_data.data(), header_data.size()) == header_data.size());
+    CHECK(std::equal(version_data.begin(), version_data.end(), header_data.begin()));
+
+    auto expected = sv::generate_header(seed, version_data);
+    CHECK(header_data == expected.data);
+
+    auto [key, ctr] = sv::get_keys(header);
+    CHECK((key == expected.key) && (ctr == expected.ctr));
+
+    std::vector<std::uint8_t> ciphertext(image.size());
+    CHECK(main.read(ciphertext.data(), ciphertext.size()) == ciphertext.size());
+    CHECK(ciphertext != image);
+
+    auto plain = sv::decrypt(main, main.size(), key, ctr);
+    CHECK((plain.size() == image.size()) && std::equal(plain.begin(), plain.end(), image.begin()));
+}
+
+} // namespace
+
+int main() {
+    auto dir = test::make_temp_dir();
+    auto fs  = fs::Filesystem(dir);
+
+    std::array<std::uint8_t, 0x100> version_data;
+    for (std::size_t i = 0; i < version_data.size(); ++i)
+        version_data[i] = i;
+
+    std::array<std::uint8_t, sv::header_size> header = {};
+    std::copy(version_data.begin(), version_data.end(), header.begin());
+    create(fs, "/mainHeader.dat", header.data(), header.size());
+
+    // Starts out with a file of the wrong size, and an image not a multiple of the AES block size
+    auto image = make_image(0x123458, 1);
+    create(fs, "/main.dat", image.data(), 0x1000);
+    check_round_trip(fs, image, 0x1234, version_data);
+
+    // Saving again rotates the key and counter
+    image[0x100] ^= 0xff;
+    check_round_trip(fs, image, 0xcafe, version_data);
+
+    test::remove_dir(dir);
+    return test::report("save_write");
+}
@@ -0,0 +1,56 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Minimal harness shared by the host tests, built and run with `make check`
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#define CHECK(cond) \
+    ((cond) ? (void)0 : (void)(++test::failures, fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond)))
+
+namespace test {
+
+inline int failures = 0;
+
+// Fresh directory for the files of a test, standing in for a mounted filesystem
+inline std::string make_temp_dir() {
+    char path[] = "/tmp/turnips-test-XXXXXX";
+    if (!mkdtemp(path)) {
+        fprintf(stderr, "Failed to create a temporary directory\n");
+        std::exit(1);
+    }
+    return path;
+}
+
+inline void remove_dir(const std::string &path) {
+    std::system(("rm -rf '" + path + "'").c_str());
+}
+
+inline int report(const char *name) {
+    if (failures)
+        fprintf(stderr, "%s: %d check(s) failed\n", name, failures);
+    else
+        printf("%s: ok\n", name);
+    return failures ? 1 : 0;
+}
+
+} // namespace test
@@ -0,0 +1,302 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Converts an image into a texture the application uploads without decoding:
+//   bg2tex [-r] [-h height] input.png output.tex
+// The image is downscaled with an area filter to the given height (keeping its aspect ratio), and compressed to BC1 unless -r keeps it RGBA8
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <unistd.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include <stb_image.h>
+
+#include "texture.hpp"
+
+namespace {
+
+struct Image {
+    std::uint32_t width = 0, height = 0;
+    std::vector<std::uint8_t> pixels; // RGBA8
+};
+
+void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-r] [-h height] input.png output.tex\n", name);
+}
+
+// Each destination pixel averages the source area it covers, weighting partially covered source pixels
+std::vector<float> make_weights(std::uint32_t src, std::uint32_t dst, std::vector<std::uint32_t> &first) {
+    auto scale = static_cast<float>(src) / dst;
+    auto span  = static_cast<std::uint32_t>(scale) + 2;
+    std::vector<float> weights(dst * span);
+    first.resize(dst);
+    for (std::uint32_t i = 0; i < dst; ++i) {
+        float begin = i * scale, end = begin + scale;
+        first[i] = static_cast<std::uint32_t>(begin);
+        for (std::uint32_t j = 0; j < span; ++j) {
+            float lo = std::max(begin, static_cast<float>(first[i] + j)), hi = std::min(end, static_cast<float>(first[i] + j + 1));
+            weights[i * span + j] = (first[i] + j < src) ? std::max(hi - lo, 0.0f) / scale : 0.0f;
+        }
+    }
+    return weights;
+}
+
+Image resize(const Image &src, std::uint32_t width, std::uint32_t height) {
+    if ((src.width == width) && (src.height == height))
+        return src;
+
+    std::vector<std::uint32_t> first_x, first_y;
+    auto weights_x = make_weights(src.width,  width,  first_x), weights_y = make_weights(src.height, height, first_y);
+    auto span_x = weights_x.size() / width, span_y = weights_y.size() / height;
+
+    // Horizontal pass, then vertical
+    std::vector<float> tmp(width * src.height * 4);
+    for (std::uint32_t y = 0; y < src.height; ++y) {
+        for (std::uint32_t x = 0; x < width; ++x) {
+            for (std::size_t j = 0; j < span_x; ++j) {
+                auto w = weights_x[x * span_x + j];
+                if (w == 0.0f)
+                    continue;
+                auto *p = &src.pixels[(y * src.width + first_x[x] + j) * 4];
+                for (auto c = 0; c < 4; ++c)
+                    tmp[(y * width + x) * 4 + c] += w * p[c];
+            }
+        }
+    }
+
+    Image res{ width, height, std::vector<std::uint8_t>(width * height * 4) };
+    for (std::uint32_t y = 0; y < height; ++y) {
+        for (std::uint32_t x = 0; x < width; ++x) {
+            std::array<float, 4> acc = {};
+            for (std::size_t j = 0; j < span_y; ++j) {
+                auto w = weights_y[y * span_y + j];
+                if (w == 0.0f)
+                    continue;
+                for (auto c = 0; c < 4; ++c)
+                    acc[c] += w * tmp[((first_y[y] + j) * width + x) * 4 + c];
+            }
+            for (auto c = 0; c < 4; ++c)
+                res.pixels[(y * width + x) * 4 + c] = static_cast<std::uint8_t>(std::clamp(acc[c] + 0.5f, 0.0f, 255.0f));
+        }
+    }
+    return res;
+}
+
+std::uint16_t to_565(const std::array<int, 3> &c) {
+    return ((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255);
+}
+
+std::array<int, 3> from_565(std::uint16_t c) {
+    return { (c >> 11) * 255 / 31, ((c >> 5) & 63) * 255 / 63, (c & 31) * 255 / 31 };
+}
+
+struct Bc1Block {
+    std::uint16_t c0 = 0, c1 = 0;
+    std::uint32_t indices = 0;
+    int           error   = INT32_MAX; // Sum of the squared differences to the source pixels
+};
+
+// Quantizes the endpoints and picks the closest palette color for every pixel
+Bc1Block fit_bc1_block(const std::array<std::array<int, 3>, 16> &block, const std::array<int, 3> &e0, const std::array<int, 3> &e1) {
+    Bc1Block res;
+    res.c0 = to_565(e0), res.c1 = to_565(e1);
+
+    // c0 > c1 selects the four color mode, equal endpoints leave a single color
+    if (res.c0 < res.c1)
+        std::swap(res.c0, res.c1);
+    auto q0 = from_565(res.c0), q1 = from_565(res.c1);
+    std::array<std::array<int, 3>, 4> palette;
+    for (auto c = 0; c < 3; ++c) {
+        palette[0][c] = q0[c], palette[1][c] = q1[c];
+        palette[2][c] = (2 * q0[c] + q1[c]) / 3, palette[3][c] = (q0[c] + 2 * q1[c]) / 3;
+    }
+    auto num_colors = (res.c0 != res.c1) ? palette.size() : 1;
+
+    res.error = 0;
+    for (std::size_t i = 0; i < block.size(); ++i) {
+        std::uint32_t best = 0;
+        int best_dist = INT32_MAX;
+        for (std::uint32_t j = 0; j < num_colors; ++j) {
+            int dist = 0;
+            for (auto c = 0; c < 3; ++c)
+                dist += (block[i][c] - palette[j][c]) * (block[i][c] - palette[j][c]);
+            if (dist < best_dist)
+                best = j, best_dist = dist;
+        }
+        res.indices |= best << (2 * i);
+        res.error   += best_dist;
+    }
+    return res;
+}
+
+// Endpoints that best reproduce the block with the indices of a fit, in the least squares sense.
+// Returns false when the indices don't constrain both endpoints
+bool refit_bc1_endpoints(const std::array<std::array<int, 3>, 16> &block, const Bc1Block &fit,
+        std::array<int, 3> &e0, std::array<int, 3> &e1) {
+    // Weight of c0 for each index, c1 gets the rest
+    constexpr std::array<float, 4> weights = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    std::array<float, 3> ap = {}, bp = {};
+    for (std::size_t i = 0; i < block.size(); ++i) {
+        auto a = weights[(fit.indices >> (2 * i)) & 3], b = 1.0f - a;
+        aa += a * a, ab += a * b, bb += b * b;
+        for (auto c = 0; c < 3; ++c)
+            ap[c] += a * block[i][c], bp[c] += b * block[i][c];
+    }
+
+    auto det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-3f)
+        return false;
+    for (auto c = 0; c < 3; ++c) {
+        e0[c] = std::clamp(static_cast<int>(std::lround((bb * ap[c] - ab * bp[c]) / det)), 0, 255);
+        e1[c] = std::clamp(static_cast<int>(std::lround((aa * bp[c] - ab * ap[c]) / det)), 0, 255);
+    }
+    return true;
+}
+
+// Endpoints from the pixels at both ends of the principal axis of the block colors, which follows the colors
+// whichever way the channels vary together, then refined against the chosen indices. Alpha is dropped
+void encode_bc1_block(const std::array<std::array<int, 3>, 16> &block, std::uint8_t *out) {
+    std::array<float, 3> mean = {};
+    for (auto &p: block)
+        for (auto c = 0; c < 3; ++c)
+            mean[c] += p[c] / 16.0f;
+
+    std::array<std::array<float, 3>, 3> cov = {};
+    for (auto &p: block)
+        for (auto i = 0; i < 3; ++i)
+            for (auto j = 0; j < 3; ++j)
+                cov[i][j] += (p[i] - mean[i]) * (p[j] - mean[j]);
+
+    // Power iteration, the axis is rescaled at each step to keep it in range
+    std::array<float, 3> axis = { 1.0f, 1.0f, 1.0f };
+    for (auto iter = 0; iter < 8; ++iter) {
+        std::array<float, 3> next = {};
+        for (auto i = 0; i < 3; ++i)
+            next[i] = cov[i][0] * axis[0] + cov[i][1] * axis[1] + cov[i][2] * axis[2];
+        auto norm = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (norm < 1e-6f)
+            break;
+        for (auto i = 0; i < 3; ++i)
+            axis[i] = next[i] / norm;
+    }
+
+    std::size_t lo = 0, hi = 0;
+    float lo_dot = INFINITY, hi_dot = -INFINITY;
+    for (std::size_t i = 0; i < block.size(); ++i) {
+        auto dot = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+        if (dot < lo_dot)
+            lo = i, lo_dot = dot;
+        if (dot > hi_dot)
+            hi = i, hi_dot = dot;
+    }
+
+    auto best = fit_bc1_block(block, block[hi], block[lo]);
+    for (auto iter = 0; (iter < 2) && best.error; ++iter) {
+        std::array<int, 3> e0, e1;
+        if (!refit_bc1_endpoints(block, best, e0, e1))
+            break;
+        auto fit = fit_bc1_block(block, e0, e1);
+        if (fit.error >= best.error)
+            break;
+        best = fit;
+    }
+
+    std::memcpy(out + 0, &best.c0,      sizeof(best.c0));
+    std::memcpy(out + 2, &best.c1,      sizeof(best.c1));
+    std::memcpy(out + 4, &best.indices, sizeof(best.indices));
+}
+
+std::vector<std::uint8_t> encode_bc1(const Image &image) {
+    auto blocks_x = (image.width + 3) / 4, blocks_y = (image.height + 3) / 4;
+    std::vector<std::uint8_t> res(blocks_x * blocks_y * 8);
+    for (std::uint32_t by = 0; by < blocks_y; ++by) {
+        for (std::uint32_t bx = 0; bx < blocks_x; ++bx) {
+            // Edge blocks repeat the last row and column
+            std::array<std::array<int, 3>, 16> block;
+            for (std::uint32_t i = 0; i < 16; ++i) {
+                auto x = std::min(bx * 4 + i % 4, image.width - 1), y = std::min(by * 4 + i / 4, image.height - 1);
+                auto *p = &image.pixels[(y * image.width + x) * 4];
+                block[i] = { p[0], p[1], p[2] };
+            }
+            encode_bc1_block(block, &res[(by * blocks_x + bx) * 8]);
+        }
+    }
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    auto format = tx::Format::BC1;
+    std::uint32_t height = 0;
+
+    for (int opt; (opt = getopt(argc, argv, "rh:")) != -1;) {
+        switch (opt) {
+            case 'r': format = tx::Format::RGBA8; break;
+            case 'h': height = std::strtoul(optarg, nullptr, 0); break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int w, h, nchan;
+    auto *data = stbi_load(argv[optind], &w, &h, &nchan, 4);
+    if (!data) {
+        fprintf(stderr, "%s: %s\n", argv[optind], stbi_failure_reason());
+        return 1;
+    }
+
+    Image image{ static_cast<std::uint32_t>(w), static_cast<std::uint32_t>(h), std::vector<std::uint8_t>(data, data + w * h * 4) };
+    stbi_image_free(data);
+
+    if (height && (height != image.height))
+        image = resize(image, (image.width * height + image.height / 2) / image.height, height);
+
+    auto pixels = (format == tx::Format::BC1) ? encode_bc1(image) : std::move(image.pixels);
+
+    auto header = tx::TextureHeader{ tx::texture_magic, format, image.width, image.height, static_cast<std::uint32_t>(pixels.size()), {} };
+
+    auto *fp = fopen(argv[optind + 1], "wb");
+    if (!fp) {
+        fprintf(stderr, "%s: failed to open\n", argv[optind + 1]);
+        return 1;
+    }
+    auto ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok &= fwrite(pixels.data(), 1, pixels.size(), fp) == pixels.size();
+    ok &= !fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "%s: failed to write\n", argv[optind + 1]);
+        std::remove(argv[optind + 1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Compiles a language file into the string table loaded by the application:
+//   lang2bin input.json output.bin
+// Keys missing from the file fall back to their name, keys unknown to src/lang_keys.hpp are reported and dropped.
+// The glyph ranges stored with the strings cover every character they use, plus the language names
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+#include "lang_keys.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+std::string read_file(const char *path) {
+    std::string res;
+    if (auto *fp = fopen(path, "rb"); fp) {
+        char buf[0x1000];
+        for (std::size_t read; (read = fread(buf, 1, sizeof(buf), fp));)
+            res.append(buf, read);
+        fclose(fp);
+    }
+    return res;
+}
+
+void flatten(const json &obj, const std::string &prefix, std::vector<std::pair<std::string, std::string>> &out) {
+    for (auto &[key, value]: obj.items()) {
+        if (value.is_object())
+            flatten(value, prefix + key + ".", out);
+        else if (value.is_string())
+            out.emplace_back(prefix + key, value.get<std::string>());
+    }
+}
+
+// Invalid sequences are skipped, they would be rendered as the fallback glyph anyway
+void add_codepoints(std::string_view str, std::set<std::uint32_t> &out) {
+    for (std::size_t i = 0; i < str.size();) {
+        auto c   = static_cast<std::uint8_t>(str[i]);
+        auto len = (c < 0x80) ? 1 : ((c & 0xe0) == 0xc0) ? 2 : ((c & 0xf0) == 0xe0) ? 3 : ((c & 0xf8) == 0xf0) ? 4 : 0;
+        if (!len || (i + len > str.size())) {
+            ++i;
+            continue;
+        }
+
+        std::uint32_t cp = (len == 1) ? c : c & (0x7f >> len);
+        for (auto j = 1; j < len; ++j)
+            cp = (cp << 6) | (static_cast<std::uint8_t>(str[i + j]) & 0x3f);
+        out.insert(cp);
+        i += len;
+    }
+}
+
+std::vector<lang::GlyphRange> make_ranges(const std::set<std::uint32_t> &codepoints) {
+    std::vector<lang::GlyphRange> res;
+    for (auto cp: codepoints) {
+        if (!res.empty() && (res.back().last + 1 == cp))
+            res.back().last = cp;
+        else
+            res.push_back({ cp, cp });
+    }
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s input.json output.bin\n", argv[0]);
+        return 1;
+    }
+
+    auto contents = read_file(argv[1]);
+    // Skip the byte order mark some editors add
+    if (contents.compare(0, 3, "\xef\xbb\xbf") == 0)
+        contents.erase(0, 3);
+
+    auto root = json::parse(contents, nullptr, false);
+    if (root.is_discarded() || !root.is_object()) {
+        fprintf(stderr, "%s: failed to parse\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> strings;
+    flatten(root, "", strings);
+
+    std::vector<std::string_view> values(lang::num_keys);
+    std::vector<bool> found(lang::num_keys);
+    for (auto &[key, value]: strings) {
+        if (auto idx = lang::find_key(key); idx < lang::num_keys)
+            values[idx] = value, found[idx] = true;
+        else
+            fprintf(stderr, "%s: unknown key %s\n", argv[1], key.c_str());
+    }
+
+    for (std::size_t i = 0; i < lang::num_keys; ++i) {
+        if (!found[i]) {
+            fprintf(stderr, "%s: missing key %.*s\n", argv[1], static_cast<int>(lang::keys[i].size()), lang::keys[i].data());
+            values[i] = lang::get_fallback(i);
+        }
+    }
+
+    std::vector<std::uint32_t> offsets;
+    std::string pool;
+    std::set<std::uint32_t> codepoints;
+    for (auto value: values) {
+        offsets.push_back(pool.size());
+        pool.append(value).push_back('\0');
+        add_codepoints(value, codepoints);
+    }
+    offsets.push_back(pool.size());
+
+    for (auto name: lang::language_names)
+        add_codepoints(name, codepoints);
+    for (auto cp = lang::base_glyph_range.first; cp <= lang::base_glyph_range.last; ++cp)
+        codepoints.insert(cp);
+    codepoints.erase('\n');
+    auto ranges = make_ranges(codepoints);
+
+    auto header = lang::TableHeader{
+        lang::table_magic, static_cast<std::uint32_t>(lang::num_keys), lang::hash_keys(),
+        static_cast<std::uint32_t>(ranges.size()), static_cast<std::uint32_t>(pool.size()),
+    };
+
+    auto *fp = fopen(argv[2], "wb");
+    if (!fp) {
+        fprintf(stderr, "%s: failed to open\n", argv[2]);
+        return 1;
+    }
+    auto ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok &= fwrite(offsets.data(), sizeof(std::uint32_t), offsets.size(), fp) == offsets.size();
+    ok &= fwrite(ranges.data(), sizeof(lang::GlyphRange), ranges.size(), fp) == ranges.size();
+    ok &= fwrite(pool.data(), 1, pool.size(), fp) == pool.size();
+    ok &= !fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "%s: failed to write\n", argv[2]);
+        std::remove(argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
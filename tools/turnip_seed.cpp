@@ -0,0 +1,138 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Host front-end of pr::SeedSearch:
+//   turnip_seed [-p previous] [-c current] [-k checkpoint] [-t threads] buy_price price...
+// Prices go from Monday AM to Saturday PM, 0 for unknown ones. Patterns are numbered as in the save (0 to 3), a previous
+// pattern of 4 is the first week after moving in, and anything above is unknown
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "predict.hpp"
+
+namespace {
+
+sr::Progress progress;
+
+void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-p previous] [-c current] [-k checkpoint] [-t threads] buy_price price...\n", name);
+}
+
+// Values past the last valid one are unknown
+pr::Pattern parse_pattern(const char *str, pr::Pattern last) {
+    auto value = std::strtoul(str, nullptr, 0);
+    return (value <= static_cast<unsigned long>(last)) ? static_cast<pr::Pattern>(value) : pr::Pattern::Unknown;
+}
+
+std::vector<std::uint8_t> read_file(const std::string &path) {
+    std::vector<std::uint8_t> res;
+    if (auto *fp = fopen(path.c_str(), "rb"); fp) {
+        std::uint8_t buf[0x1000];
+        for (std::size_t read; (read = fread(buf, 1, sizeof(buf), fp));)
+            res.insert(res.end(), buf, buf + read);
+        fclose(fp);
+    }
+    return res;
+}
+
+bool write_file(const std::string &path, const std::vector<std::uint8_t> &data) {
+    auto tmp = path + ".tmp";
+    auto *fp = fopen(tmp.c_str(), "wb");
+    if (!fp)
+        return false;
+    auto ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok &= !fclose(fp);
+    return ok && !rename(tmp.c_str(), path.c_str());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    pr::Observations obs;
+    std::string checkpoint_path;
+    std::size_t num_threads = std::thread::hardware_concurrency();
+
+    for (int opt; (opt = getopt(argc, argv, "p:c:k:t:")) != -1;) {
+        switch (opt) {
+            case 'p': obs.previous = parse_pattern(optarg, pr::Pattern::FirstWeek);  break;
+            case 'c': obs.current  = parse_pattern(optarg, pr::Pattern::SmallSpike); break;
+            case 'k': checkpoint_path = optarg; break;
+            case 't': num_threads = std::strtoul(optarg, nullptr, 0); break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if ((optind >= argc) || (argc - optind > 1 + static_cast<int>(pr::num_half_days))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    obs.buy_price = std::strtoul(argv[optind++], nullptr, 0);
+    for (std::size_t i = 0; optind < argc; ++i)
+        obs.prices[i] = std::strtoul(argv[optind++], nullptr, 0);
+
+    auto search = pr::SeedSearch(obs);
+    if (!checkpoint_path.empty()) {
+        if (auto data = read_file(checkpoint_path); !data.empty() && !search.load_checkpoint(data))
+            fprintf(stderr, "Ignoring checkpoint %s, made for other observations\n", checkpoint_path.c_str());
+    }
+
+    std::signal(SIGINT, [](int) { progress.cancel(); });
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread reporter([&search] {
+        while (!search.is_done() && !progress.cancelled) {
+            fprintf(stderr, "\r%5.1f%%, %zu seed(s) found", 100.0f * search.fraction(progress), search.get_num_found() + progress.found);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    });
+
+    while (!search.is_done() && search.step(progress, num_threads)) {
+        if (!checkpoint_path.empty() && !write_file(checkpoint_path, search.save_checkpoint()))
+            fprintf(stderr, "\nFailed to write checkpoint %s\n", checkpoint_path.c_str());
+    }
+
+    // Also wakes up the reporter if the search completed
+    progress.cancel();
+    reporter.join();
+
+    auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!search.is_done()) {
+        fprintf(stderr, "\nInterrupted after %.1fs%s\n", secs, checkpoint_path.empty() ? "" : ", resume with the same checkpoint");
+        return 2;
+    }
+    fprintf(stderr, "\rDone in %.1fs, %zu seed(s) found\n", secs, search.get_seeds().size());
+
+    for (auto seed: search.get_seeds()) {
+        pr::Week week;
+        pr::replay_any(seed, obs, &week);
+        printf("%#010x: base %u, pattern %u:", seed, week.base_price, static_cast<std::uint32_t>(week.pattern));
+        for (auto price: week.prices)
+            printf(" %u", price);
+        printf("\n");
+    }
+
+    return 0;
+}